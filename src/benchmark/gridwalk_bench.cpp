@@ -0,0 +1,288 @@
+// Micro and macro benchmarks of the grid walk hot paths
+// Output is one "kind name metric value" line per measurement so results of
+// two builds can be compared with diff or join
+#include "mc_walk.hpp"
+#include "walker.hpp"
+#include "util/dist.hpp"
+#include "util/grid.hpp"
+#include "util/grid_generator.hpp"
+#include "util/mlp.hpp"
+#include "util/rand.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef GRIDWALK_EXAMPLES_DIR
+#define GRIDWALK_EXAMPLES_DIR "examples"
+#endif
+
+// Accumulator of benchmark results so the optimizer cannot discard the work
+static volatile double sink = 0;
+
+// Benchmark settings
+struct BenchSettings {
+  // Minimum time spent in each micro benchmark
+  double _min_seconds = 0.2;
+  // Number of histories per macro benchmark
+  double _num_samples = 2000;
+  // Only benchmarks whose names contain this string are run
+  std::string _filter;
+  // Directory holding the example grids
+  std::string _examples_dir = GRIDWALK_EXAMPLES_DIR;
+};
+
+// Named grid used by the benchmarks
+struct NamedGrid {
+  std::string _name;
+  Grid _grid;
+};
+
+// Print a single measurement
+static void report(
+    const std::string & kind, const std::string & name,
+    const std::string & metric, double value) {
+  std::cout << kind << " " << name << " " << metric << " ";
+  std::cout << std::fixed << std::setprecision(3) << value << "\n";
+  std::cout.flush();
+}
+
+// Calls op in batches until min_seconds has elapsed and returns the average
+// number of nanoseconds per call
+template <typename Op>
+static double time_op(Op op, double min_seconds) {
+  unsigned long long calls = 0;
+  unsigned long long batch = 1;
+  double total = 0;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  while (elapsed < min_seconds) {
+    for (unsigned long long i = 0; i < batch; i++) { total += op(); }
+    calls += batch;
+    batch *= 2;
+    elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+  sink = sink + total;
+  return 1e9*elapsed/calls;
+}
+
+// Run a micro benchmark if it passes the filter
+template <typename Op>
+static void run_micro(
+    const BenchSettings & settings, const std::string & name, Op op) {
+  if (name.find(settings._filter) == std::string::npos) { return; }
+  report("micro", name, "ns_per_op", time_op(op, settings._min_seconds));
+}
+
+// Returns all reachable nodes of the grid
+static std::vector<util::Coord> reachable_nodes(const Grid & grid) {
+  std::vector<util::Coord> nodes;
+  for (unsigned int y = 0; y < grid.get_y_dim(); y++) {
+    for (unsigned int x = 0; x < grid.get_x_dim(); x++) {
+      util::Coord coord(x, y);
+      if (grid.is_reachable(coord)) { nodes.push_back(coord); }
+    }
+  }
+  return nodes;
+}
+
+// Micro benchmarks of the grid queries and walker step on one grid
+static void grid_micro_benchmarks(
+    const BenchSettings & settings, const NamedGrid & named) {
+  const Grid & grid = named._grid;
+  std::vector<util::Coord> nodes = reachable_nodes(grid);
+  if (nodes.empty()) { return; }
+
+  size_t idx = 0;
+  run_micro(settings, "grid_get_directions/"+named._name, [&]() {
+    idx = (idx+1 == nodes.size()) ? 0 : idx+1;
+    return static_cast<double>(grid.get_directions(nodes[idx]).size());
+  });
+
+  idx = 0;
+  unsigned int dir = 0;
+  run_micro(settings, "grid_get_distance/"+named._name, [&]() {
+    dir = (dir+1) % util::all_directions.size();
+    if (dir == 0) { idx = (idx+1 == nodes.size()) ? 0 : idx+1; }
+    return static_cast<double>(
+      grid.get_distance(nodes[idx], util::all_directions[dir]));
+  });
+
+  Walker walker;
+  walker.set_position(grid.get_start());
+  auto goal = grid.get_goal();
+  run_micro(settings, "walker_step/"+named._name, [&]() {
+    if (walker.at_coordinate(goal)) { walker.set_position(grid.get_start()); }
+    walker.step(&grid);
+    return 1.0;
+  });
+}
+
+// Micro benchmarks of the random number generator and each distribution
+static void distribution_micro_benchmarks(const BenchSettings & settings) {
+  util::RNG rng;
+  run_micro(settings, "rng_sample", [&]() { return rng.sample(); });
+
+  util::PDF pdf((util::RNG()));
+  run_micro(settings, "pdf_sample/truncated_exponential", [&]() {
+    return static_cast<double>(
+      pdf.sample(8, 1.0, util::dist_type::truncated_exponential));
+  });
+  const std::vector<double> probabilities =
+    {0.3, 0.05, 0.1, 0.05, 0.2, 0.1, 0.1, 0.1};
+  run_micro(settings, "pdf_sample/categorical", [&]() {
+    return static_cast<double>(
+      pdf.sample(probabilities, util::dist_type::categorical));
+  });
+  const std::vector<double> means =
+    {0.125, 0.125, 0.125, 0.125, 0.125, 0.125, 0.125, 0.125, 1.0};
+  run_micro(settings, "pdf_sample/guassian", [&]() {
+    return pdf.sample(means, 0.1, 1.0, util::dist_type::guassian).back();
+  });
+  std::vector<double> samples(means.size());
+  run_micro(settings, "pdf_sample/guassian_buffer", [&]() {
+    pdf.sample(means.data(), means.size(), 0.1, 1.0, samples.data(),
+               util::dist_type::guassian);
+    return samples.back();
+  });
+  run_micro(settings, "pdf_sample/uniform", [&]() {
+    return pdf.sample(util::dist_type::uniform);
+  });
+}
+
+// Batch scoring with a randomly initialized network of the surrogate shape,
+// reported per candidate
+static void surrogate_micro_benchmarks(const BenchSettings & settings) {
+  const unsigned int sizes[] = {9, 64, 128, 64, 1};
+  util::RNG rng;
+  util::MLP model;
+  for (unsigned int l = 0; l+1 < sizeof(sizes)/sizeof(sizes[0]); l++) {
+    std::vector<float> weights(sizes[l]*sizes[l+1]);
+    std::vector<float> biases(sizes[l+1]);
+    for (float & w : weights) { w = (rng.sample() - 0.5)/sizes[l]; }
+    for (float & b : biases) { b = rng.sample() - 0.5; }
+    model.add_layer(sizes[l], sizes[l+1], weights, biases);
+  }
+  const size_t batch = 1 << 14;
+  std::vector<float> candidates(batch*sizes[0]);
+  for (float & c : candidates) { c = rng.sample(); }
+  std::vector<float> predictions(batch);
+  for (unsigned int threads : {1u, 0u}) {
+    std::string name = "mlp_predict/" +
+      (threads == 1 ? std::string("1_thread") : std::string("all_threads"));
+    if (name.find(settings._filter) == std::string::npos) { continue; }
+    double ns = time_op([&]() {
+      model.predict(candidates.data(), batch, predictions.data(), threads);
+      return predictions[0];
+    }, settings._min_seconds);
+    report("micro", name, "ns_per_candidate", ns/batch);
+  }
+}
+
+// Time the analog walk on a grid and report throughput
+static void macro_benchmark(
+    const BenchSettings & settings, NamedGrid & named) {
+  std::string name = "walk_grid/"+named._name;
+  if (name.find(settings._filter) == std::string::npos) { return; }
+  MCWalk walk(&named._grid);
+  auto start = std::chrono::steady_clock::now();
+  double mean = walk.walk_grid(settings._num_samples);
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  double steps = mean*settings._num_samples;
+  report("macro", name, "histories_per_sec", settings._num_samples/seconds);
+  report("macro", name, "ns_per_step", 1e9*seconds/steps);
+  report("macro", name, "mean_steps", mean);
+}
+
+// Reads a grid from the examples directory
+static Grid read_example(
+    const BenchSettings & settings, const std::string & filename) {
+  std::string path = settings._examples_dir+"/"+filename;
+  std::ifstream grid_input(path);
+  if (!grid_input.is_open()) {
+    throw std::runtime_error("Failed to open "+path);
+  }
+  return Grid(grid_input);
+}
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_bench [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --quick              short runs for smoke testing\n";
+  std::cout << "  --filter string      only run benchmarks containing ";
+  std::cout << "string\n";
+  std::cout << "  --examples dir       directory holding spiral.txt";
+  std::cout << std::endl;
+}
+
+int main(int argc, char* argv []) {
+  BenchSettings settings;
+  for (int i = 1; i < argc; i++) {
+    std::string option(argv[i]);
+    if (option == "--quick") {
+      settings._min_seconds = 0.02;
+      settings._num_samples = 200;
+    }
+    else if (option == "--filter" && i+1 < argc) {
+      settings._filter = argv[++i];
+    }
+    else if (option == "--examples" && i+1 < argc) {
+      settings._examples_dir = argv[++i];
+    }
+    else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  try {
+    // Grids for the micro benchmarks
+    std::vector<NamedGrid> micro_grids;
+    micro_grids.push_back({"spiral", read_example(settings, "spiral.txt")});
+    micro_grids.push_back(
+      {"open_64", util::generate_grid(util::open_field, 64, 64)});
+    micro_grids.push_back(
+      {"maze_33", util::generate_grid(util::maze, 33, 33)});
+
+    // Grids for the macro benchmarks, sizes are limited so the analog walk
+    // stays well below the maximum number of steps per history
+    std::vector<NamedGrid> macro_grids;
+    macro_grids.push_back({"spiral", read_example(settings, "spiral.txt")});
+    for (unsigned int size : {16, 32, 64}) {
+      macro_grids.push_back({"open_"+std::to_string(size),
+        util::generate_grid(util::open_field, size, size)});
+    }
+    for (unsigned int size : {9, 17, 33}) {
+      macro_grids.push_back({"maze_"+std::to_string(size),
+        util::generate_grid(util::maze, size, size)});
+    }
+    for (unsigned int size : {12, 16, 20}) {
+      macro_grids.push_back({"corridor_"+std::to_string(size),
+        util::generate_grid(util::corridor, size, size)});
+    }
+
+    std::cout << "# kind name metric value\n";
+    distribution_micro_benchmarks(settings);
+    surrogate_micro_benchmarks(settings);
+    for (const auto & named : micro_grids) {
+      grid_micro_benchmarks(settings, named);
+    }
+    for (auto & named : macro_grids) {
+      macro_benchmark(settings, named);
+    }
+  }
+  catch (const std::runtime_error & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
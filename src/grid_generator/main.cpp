@@ -0,0 +1,96 @@
+// Generates synthetic grids in the format read by gridwalk
+#include "util/grid.hpp"
+#include "util/grid_generator.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_gen [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --type open|maze|corridor|rooms  layout (default open)\n";
+  std::cout << "  --size x y           nodes per dimension (default 10 10)\n";
+  std::cout << "  --density d          fraction of nodes randomly blocked\n";
+  std::cout << "  --room-size n        nodes per side of rooms (default 8)\n";
+  std::cout << "  --seed s             random number generator seed\n";
+  std::cout << "  --format text|binary grid file format (default text)\n";
+  std::cout << "  --output file        grid file name (default stdout for ";
+  std::cout << "text)" << std::endl;
+}
+
+int main(int argc, char* argv []) {
+  util::GridSpec spec;
+  util::grid_format format = util::grid_format::text_grid;
+  std::string output_filename;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string option(argv[i]);
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--type") {
+        spec._type = util::to_grid_type(argv[++i]);
+      }
+      else if (option == "--size" && i+2 < argc) {
+        spec._x_dim = std::stoul(argv[++i]);
+        spec._y_dim = std::stoul(argv[++i]);
+      }
+      else if (option == "--density") {
+        spec._obstacle_density = std::stod(argv[++i]);
+      }
+      else if (option == "--room-size") {
+        spec._room_size = std::stoul(argv[++i]);
+      }
+      else if (option == "--seed") {
+        spec._seed = std::stod(argv[++i]);
+      }
+      else if (option == "--format") {
+        std::string name(argv[++i]);
+        if (name == "text") { format = util::grid_format::text_grid; }
+        else if (name == "binary") { format = util::grid_format::binary_grid; }
+        else {
+          throw std::runtime_error("Grid format "+name+" not recognized");
+        }
+      }
+      else if (option == "--output") {
+        output_filename = argv[++i];
+      }
+      else {
+        throw std::runtime_error("Unknown option "+option);
+      }
+    }
+    if (format == util::grid_format::binary_grid && output_filename.empty()) {
+      throw std::runtime_error("Binary grids must be written with --output");
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  try {
+    Grid grid = util::generate_grid(spec);
+    if (output_filename.empty()) {
+      grid.write(std::cout, format);
+    }
+    else {
+      std::ofstream output_file(
+        output_filename, std::ios::out | std::ios::binary);
+      if (!output_file.is_open()) {
+        std::cout << "Failed to open "+output_filename << std::endl;
+        return 2;
+      }
+      grid.write(output_file, format);
+    }
+  }
+  catch (const std::runtime_error & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
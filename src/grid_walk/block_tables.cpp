@@ -0,0 +1,70 @@
+#include "block_tables.hpp"
+
+#include <stdexcept>
+
+BlockTables::BlockTables(
+    const Grid * grid, unsigned int block_size, unsigned int table_samples,
+    unsigned int exact_radius, uint32_t max_local_steps)
+    : _grid(grid), _block_size(block_size), _table_samples(table_samples),
+      _exact_radius(exact_radius), _max_local_steps(max_local_steps),
+      _tables(static_cast<size_t>(grid->get_x_dim())*grid->get_y_dim()) {
+  if (_block_size == 0 || _table_samples == 0) {
+    throw std::runtime_error(
+      "Block size and table samples must be positive");
+  }
+  _goal_bx = grid->get_goal()._x_coord / _block_size;
+  _goal_by = grid->get_goal()._y_coord / _block_size;
+  // Nodes within exact_radius blocks of the goal block are walked exactly
+  _exact.resize(_tables.size());
+  for (unsigned int y = 0; y < grid->get_y_dim(); y++) {
+    for (unsigned int x = 0; x < grid->get_x_dim(); x++) {
+      unsigned int bx = x / _block_size;
+      unsigned int by = y / _block_size;
+      unsigned int dx = bx > _goal_bx ? bx - _goal_bx : _goal_bx - bx;
+      unsigned int dy = by > _goal_by ? by - _goal_by : _goal_by - by;
+      _exact[static_cast<size_t>(y)*grid->get_x_dim() + x] =
+        dx <= _exact_radius && dy <= _exact_radius;
+    }
+  }
+}
+
+uint32_t BlockTables::leave_block(Walker & walker) {
+  const util::Coord start = walker.get_position();
+  const uint32_t node = start._y_coord*_grid->get_x_dim() + start._x_coord;
+  std::vector<Exit> & table = _tables[node];
+  if (table.size() == _table_samples) {
+    unsigned int idx = _rng.sample()*_table_samples;
+    if (idx == _table_samples) { --idx; }
+    const Exit & exit = table[idx];
+    walker.set_position(to_coord(exit._node));
+    return exit._steps;
+  }
+  if (table.empty()) {
+    table.reserve(_table_samples);
+    ++_num_tables;
+  }
+  // The local walk from the node is independent of how the walker reached
+  // it, so walking it exactly both moves the walker and samples the table
+  const util::Coord goal = _grid->get_goal();
+  const unsigned int bx = start._x_coord / _block_size;
+  const unsigned int by = start._y_coord / _block_size;
+  uint32_t steps = 0;
+  // Walk until the block is left or the goal is reached
+  do {
+    walker.step(_grid);
+    ++steps;
+  } while (walker.get_position()._x_coord / _block_size == bx &&
+           walker.get_position()._y_coord / _block_size == by &&
+           !walker.at_coordinate(goal) && steps < _max_local_steps);
+  const util::Coord & end = walker.get_position();
+  table.push_back({end._y_coord*_grid->get_x_dim() + end._x_coord, steps});
+  return steps;
+}
+
+void BlockTables::clear(double seed, uint64_t group) {
+  for (auto & table : _tables) {
+    std::vector<Exit>().swap(table);
+  }
+  _num_tables = 0;
+  _rng.set_seed(seed, outcome_stream + group);
+}
@@ -0,0 +1,89 @@
+#ifndef __BLOCK_TABLES_HEADER__
+#define __BLOCK_TABLES_HEADER__
+
+#include "util/coord.hpp"
+#include "util/grid.hpp"
+#include "util/rand.hpp"
+#include "walker.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Block decomposition of a grid for the accelerated walk engine. The grid is
+// partitioned into square blocks and, for the active PMF, each node a walker
+// enters gets a table of sampled (exit node, steps taken) outcomes of local
+// walks from that node until the walker leaves its block or reaches the
+// goal. Walkers then jump from block to block by sampling the tables and only
+// step exactly in the blocks near the goal. Tables are filled by the walkers
+// themselves: the first table_samples walkers leaving a node step exactly
+// and add their outcome to its table, so tables cost no walks beyond those
+// of the histories and only visited nodes cost memory.
+class BlockTables {
+public:
+  // Single sampled outcome of a local walk
+  struct Exit {
+    // Node index, y*x_dim + x, where the local walk left the block
+    uint32_t _node;
+    // Number of steps taken by the local walk
+    uint32_t _steps;
+  };
+
+private:
+  // Grid being walked on
+  const Grid * _grid;
+  // Nodes per side of each block
+  unsigned int _block_size;
+  // Number of local walks sampled per table
+  unsigned int _table_samples;
+  // Blocks within this many blocks of the goal block are walked exactly
+  unsigned int _exact_radius;
+  // Block holding the goal
+  unsigned int _goal_bx, _goal_by;
+  // Longest local walk before giving up on leaving the block
+  uint32_t _max_local_steps;
+  // 1 for nodes walked exactly, checked every step so kept per node rather
+  // than divided out of the coordinates
+  std::vector<uint8_t> _exact;
+  // Table of each node, filled as walkers leave the node
+  std::vector<std::vector<Exit>> _tables;
+  // Number of tables started
+  size_t _num_tables = 0;
+  // Selects outcomes from the tables, separate from the walker RNG
+  util::RNG _rng;
+
+public:
+  BlockTables(
+    const Grid * grid, unsigned int block_size, unsigned int table_samples,
+    unsigned int exact_radius = 1, uint32_t max_local_steps = 100000);
+  ~BlockTables() {};
+
+  // Returns true if walkers at coord must step exactly
+  bool is_exact(const util::Coord & coord) const {
+    return _exact[coord._y_coord*_grid->get_x_dim() + coord._x_coord];
+  }
+
+  // Moves the walker out of its block, or to the goal, and returns the steps
+  // taken. Jumps to a sampled outcome once the table of the node is full,
+  // otherwise steps exactly and adds the outcome to the table.
+  uint32_t leave_block(Walker & walker);
+
+  // Returns the coordinate of a node index
+  util::Coord to_coord(uint32_t node) const {
+    return util::Coord(node % _grid->get_x_dim(), node / _grid->get_x_dim());
+  }
+
+  // Substream of the walker seed selecting outcomes, far from the
+  // substreams of the history chunks of sharded walks
+  static const uint64_t outcome_stream = uint64_t(1) << 63;
+
+  // Drop all tables, required whenever the PMF changes, and reset the
+  // outcome RNG to substream outcome_stream + group of the passed seed, so
+  // outcomes are drawn independently of the numbers that built the tables
+  // and each group of tables selects its own outcomes
+  void clear(double seed, uint64_t group = 0);
+
+  // Number of tables started since the last clear
+  size_t num_tables() const { return _num_tables; }
+};
+
+#endif
@@ -1,22 +1,105 @@
 #include "walk_manager.hpp"
+#include "util/npy_writer.hpp"
+#include "util/perf_counters.hpp"
+#include "util/results_writer.hpp"
 
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk grid_file walk_params_file [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --format csv|binary  results file format (default csv)\n";
+  std::cout << "  --output file        results file name\n";
+  std::cout << "  --downsample k       sum spatial distributions over k x k ";
+  std::cout << "blocks (default 1)\n";
+  std::cout << "  --perf file          write per walk performance counters ";
+  std::cout << "as JSON lines\n";
+  std::cout << "  --cache file         reuse and record results in a ";
+  std::cout << "persistent result cache\n";
+  std::cout << "  --record file        record every move of every history ";
+  std::cout << "for gridwalk_replay\n";
+  std::cout << "  --shard i/N          walk shard i of N and write partial ";
+  std::cout << "results for gridwalk_merge\n";
+  std::cout << "  --shard-mode histories|entries  split the histories of ";
+  std::cout << "every case or the cases (default histories)" << std::endl;
+}
+
 int main(int argc, char* argv []) {
-  if (argc != 3) {
+  if (argc < 3) {
     std::cout << "Must pass both grid and walk parameter specification files";
     std::cout << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  // Parse optional arguments
+  util::results_format format = util::results_format::csv;
+  std::string output_filename;
+  unsigned int downsample = 1;
+  std::string perf_filename;
+  std::string cache_filename;
+  std::string record_filename;
+  bool sharded = false;
+  unsigned int shard = 0;
+  unsigned int num_shards = 1;
+  util::shard_mode shard_mode = util::shard_mode::shard_histories;
+  try {
+    for (int i = 3; i < argc; i++) {
+      std::string option(argv[i]);
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--format") {
+        format = util::to_results_format(argv[++i]);
+      }
+      else if (option == "--output") {
+        output_filename = argv[++i];
+      }
+      else if (option == "--downsample") {
+        int value = std::stoi(argv[++i]);
+        if (value < 1) {
+          throw std::runtime_error("Downsample factor must be positive");
+        }
+        downsample = value;
+      }
+      else if (option == "--perf") {
+        perf_filename = argv[++i];
+      }
+      else if (option == "--cache") {
+        cache_filename = argv[++i];
+      }
+      else if (option == "--record") {
+        record_filename = argv[++i];
+      }
+      else if (option == "--shard") {
+        util::to_shard(argv[++i], shard, num_shards);
+        sharded = true;
+      }
+      else if (option == "--shard-mode") {
+        shard_mode = util::to_shard_mode(argv[++i]);
+      }
+      else {
+        throw std::runtime_error("Unknown option "+option);
+      }
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
     return 1;
   }
 
   // Open input file with grid description and build Grid class
   std::ifstream grid_input;
   std::string grid_filename(argv[1]);
-  grid_input.open(grid_filename);
+  grid_input.open(grid_filename, std::ios::in | std::ios::binary);
   if(!grid_input.is_open()) {
     std::cout << "Failed to open "+grid_filename << std::endl;
     return 2;
@@ -27,7 +110,8 @@ int main(int argc, char* argv []) {
   std::cout << "Mesh grid read in successfully\n" << std::endl;
 
   // Open input file with the biased PMF parameters to simulate and build
-  // monte carlo simulation manager class
+  // monte carlo simulation manager class, entries are read as they are run
+  // so the file is kept open until all walks are complete
   std::ifstream biased_PMF_input;
   std::string PMF_filename(argv[2]);
   biased_PMF_input.open(PMF_filename);
@@ -37,28 +121,130 @@ int main(int argc, char* argv []) {
   }
   std::cout << "Reading biased PMF parameters from "+PMF_filename << std::endl;
   WalkManager MC_manager(biased_PMF_input);
-  grid_input.close();
   std::cout << "PMF parameters read in successfully\n" << std::endl;
 
-  // Run all Monte Carlo simualations, outputting results and storing FOM
-  MC_manager.execute(&mesh_grid);
+  std::string case_name =
+    std::filesystem::path(grid_filename).stem().string() + "_" +
+    std::filesystem::path(PMF_filename).stem().string();
 
-  // Save the data for training
-  std::ofstream output_file;
-  std::string grid_name(grid_filename.begin()+12, grid_filename.end()-4);
-  std::string PMF_name(PMF_filename.begin()+12, PMF_filename.end()-4);
-  std::string output_filename = grid_name+"_"+PMF_name+"_results.txt";
-  std::cout << output_filename << std::endl;
-  output_file.open(output_filename);
-  if (!output_file.is_open()) {
-    // input file name deduction failed
-    output_filename = "walk_results.txt";
-    output_file.open(output_filename);
+  // Shards write partial results only, merged by gridwalk_merge
+  if (sharded) {
+    if (!record_filename.empty()) {
+      std::cout << "Sharded runs cannot record trajectories" << std::endl;
+      return 1;
+    }
+    if (output_filename.empty()) {
+      output_filename = case_name+"_shard_"+std::to_string(shard)+"_of_"+
+        std::to_string(num_shards)+".gws";
+    }
+    try {
+      util::ShardHeader header = MC_manager.shard_header(
+        &mesh_grid, shard, num_shards, shard_mode);
+      util::ShardWriter writer(output_filename, header);
+      if (!writer.is_open()) {
+        std::cout << "Failed to open "+output_filename << std::endl;
+        return 2;
+      }
+      std::cout << "Writing partial results to " << output_filename;
+      std::cout << "\n" << std::endl;
+      MC_manager.execute_shard(&mesh_grid, writer, header);
+    }
+    catch (const std::runtime_error & e) {
+      std::cout << e.what() << std::endl;
+      return 2;
+    }
+    return 0;
+  }
+
+  // Open the results file, each case is written as it completes
+  if (output_filename.empty()) {
+    output_filename = case_name+"_results";
+    output_filename += (format == util::results_format::binary) ?
+      ".bin" : ".csv";
+  }
+  util::ResultsWriter results(output_filename, format);
+  if (!results.is_open()) {
+    std::cout << "Failed to open "+output_filename << std::endl;
+    return 2;
   }
   std::cout << "Writing PMF parameters and average steps data to ";
-  std::cout <<  output_filename << std::endl;
-  MC_manager.print_results(output_file);
-  output_file.close();
+  std::cout <<  output_filename << "\n" << std::endl;
+
+  // Open the spatial distribution file, each tracked walk is appended to a
+  // float32 array of shape (walks, rows, columns)
+  std::unique_ptr<util::NpyWriter> visits;
+  if (MC_manager.writes_visits()) {
+    std::string visits_filename = case_name+"_visits.npy";
+    visits = std::make_unique<util::NpyWriter>(visits_filename,
+      (mesh_grid.get_x_dim() + downsample - 1) / downsample,
+      (mesh_grid.get_y_dim() + downsample - 1) / downsample);
+    if (!visits->is_open()) {
+      std::cout << "Failed to open "+visits_filename << std::endl;
+      return 2;
+    }
+    MC_manager.set_visit_writer(visits.get(), downsample);
+    std::cout << "Writing spatial distributions to ";
+    std::cout << visits_filename << "\n" << std::endl;
+  }
+
+  // Open the performance counter file
+  std::ofstream perf_output;
+  if (!perf_filename.empty()) {
+    perf_output.open(perf_filename);
+    if (!perf_output.is_open()) {
+      std::cout << "Failed to open "+perf_filename << std::endl;
+      return 2;
+    }
+    MC_manager.set_perf_output(&perf_output);
+    if (!util::perf_counters_enabled) {
+      std::cout << "Hot path counters not compiled in, configure with ";
+      std::cout << "-DGRIDWALK_PERF_COUNTERS=ON for the full set\n";
+    }
+  }
+
+  // Open the result cache, cases already in the cache are not walked again
+  std::unique_ptr<util::ResultCache> result_cache;
+  if (!cache_filename.empty()) {
+    try {
+      result_cache = std::make_unique<util::ResultCache>(cache_filename);
+    }
+    catch (const std::runtime_error & e) {
+      std::cout << e.what() << std::endl;
+      return 2;
+    }
+    MC_manager.set_result_cache(result_cache.get());
+    std::cout << "Using result cache " << cache_filename << " holding ";
+    std::cout << result_cache->size() << " results\n" << std::endl;
+  }
+
+  // Open the trajectory file, every move of every history is recorded
+  std::unique_ptr<util::TrajectoryWriter> trajectories;
+  if (!record_filename.empty()) {
+    trajectories = std::make_unique<util::TrajectoryWriter>(
+      record_filename, MC_manager.trajectory_header(&mesh_grid));
+    if (!trajectories->is_open()) {
+      std::cout << "Failed to open "+record_filename << std::endl;
+      return 2;
+    }
+    MC_manager.set_trajectory_writer(trajectories.get());
+    std::cout << "Recording trajectories to ";
+    std::cout << record_filename << "\n" << std::endl;
+  }
+
+  // Run all Monte Carlo simualations, streaming results to file
+  MC_manager.execute(&mesh_grid, results);
+  biased_PMF_input.close();
+  results.close();
+  if (visits) { visits->close(); }
+  if (trajectories) {
+    std::cout << "Recorded " << trajectories->num_histories();
+    std::cout << " histories" << std::endl;
+    trajectories->close();
+  }
+  if (result_cache) {
+    std::cout << "Result cache hits: " << result_cache->num_hits();
+    std::cout << ", misses: " << result_cache->num_misses() << std::endl;
+  }
 
-  return 0; 
-}
\ No newline at end of file
+  return 0;
+}
@@ -1,15 +1,293 @@
 #include "mc_walk.hpp"
 
+#include "util/perf_counters.hpp"
+
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <stdexcept>
 
+unsigned long long MCWalk::walk_history() {
+  // Reset the weight of the walker each time through the grid
+  // [no longer used, importance sampling commented out]
+  _walker.reset_weight();
+  // Start with zero steps at the start node
+  unsigned long long walk_num_steps = 0;
+  _walker.set_position(_grid->get_start());
+  if (_track_grid) { _walker.visit_grid(_grid); }
+  if (_recorder) { _recorder->begin_history(); }
+  if (_ratios) { _ratios->begin_history(); }
+  auto goal = _grid->get_goal();
+  unsigned int until_deadline_check = deadline_interval;
+
+  // Walk until the goal is reached or the max number of steps is met
+  while (!_walker.at_coordinate(goal) && walk_num_steps < _step_limit) {
+    // Reading the clock costs more than a step, so check the deadline of
+    // budgeted walks only every deadline_interval steps
+    if (_has_deadline && --until_deadline_check == 0) {
+      until_deadline_check = deadline_interval;
+      if (std::chrono::steady_clock::now() >= _deadline) {
+        _cut_short = true;
+        break;
+      }
+    }
+    // Leave the block in one move far from the goal
+    if (_blocks && !_track_grid && !_recorder && !_ratios &&
+        !_blocks->is_exact(_walker.get_position())) {
+      walk_num_steps += _blocks->leave_block(_walker);
+      continue;
+    }
+    const util::Coord from = _walker.get_position();
+    _walker.step(_grid);
+    if (_track_grid) {
+      if (_path_tally) { _walker.visit_path(_grid); }
+      else { _walker.visit_grid(_grid); }
+    }
+    if (_recorder) {
+      _recorder->add_move(_walker.get_last_dir(), _walker.get_last_dist());
+    }
+    if (_ratios) {
+      const util::direction dir = _walker.get_last_dir();
+      _ratios->add_step(
+        _grid->get_direction_mask(from), dir, _grid->get_distance(from, dir),
+        _walker.get_last_dist());
+    }
+    ++walk_num_steps;
+  }
+  if (_recorder) { _recorder->end_history(); }
+  return walk_num_steps;
+}
+
+double MCWalk::set_aborted(unsigned long long sample) {
+  // If the max steps stop and returns a mean of the max allowed steps
+  if (_verbose) {
+    std::cout << "Max number of steps exceeded on sample " << sample;
+    std::cout << std::endl;
+  }
+  _num_steps = _max_steps;
+  _mean = _max_steps;
+  _mean_var = 0.0;
+  _FOM = 0.0;
+  if (_track_grid) { _grid->resolve_paths(); }
+  return _mean;
+}
+
+double MCWalk::set_results(
+    unsigned long long total_steps, double num_histories, double mean,
+    double mean_var) {
+  if (_track_grid) { _grid->resolve_paths(); }
+  _num_steps = total_steps / num_histories;
+  _mean = mean;
+  _mean_var = mean_var;
+  _FOM = (_num_steps > 0 && _mean_var > 0) ?
+    1.0/(_num_steps*_mean_var) : 0.0;
+  return _mean;
+}
+
+double MCWalk::walk_antithetic(double num_samples) {
+  util::RNG & rng = _walker.get_rng();
+  const unsigned long long num_pairs = std::ceil(num_samples/2);
+  const auto goal = _grid->get_goal();
+  unsigned long long total_steps = 0;
+  // Moments of the average number of steps of each pair
+  double pair_m1 = 0;
+  double pair_m2 = 0;
+  for (unsigned long long p = 0; p < num_pairs; p++) {
+    // Replay the numbers of the first history reflected for the second
+    util::RNG first_history = rng;
+    unsigned long long steps_1 = walk_history();
+    if (!_walker.at_coordinate(goal)) { return set_aborted(2*p); }
+    util::RNG after_first = rng;
+    rng = first_history;
+    rng.set_antithetic(true);
+    unsigned long long steps_2 = walk_history();
+    rng.set_antithetic(false);
+    if (!_walker.at_coordinate(goal)) { return set_aborted(2*p+1); }
+    // Continue past the numbers of the longer history so pairs share none
+    if (after_first.num_samples() > rng.num_samples()) { rng = after_first; }
+    PERF_COUNT(util::perf_counters()._histories += 2);
+    PERF_COUNT(util::perf_counters()._steps += steps_1 + steps_2);
+    total_steps += steps_1 + steps_2;
+    double pair_steps = 0.5*(steps_1 + steps_2);
+    pair_m1 += pair_steps;
+    pair_m2 += pair_steps*pair_steps;
+  }
+  double mean = pair_m1 / num_pairs;
+  return set_results(total_steps, 2.0*num_pairs, mean,
+                     (pair_m2 / num_pairs - mean*mean) / num_pairs);
+}
+
+// Groups of histories with their own tables and outcome streams are
+// independent estimates of the mean, like the randomizations of walk_sobol
+double MCWalk::walk_table_groups(double num_samples) {
+  const unsigned long long histories_per_group =
+    std::ceil(num_samples/table_groups);
+  const auto goal = _grid->get_goal();
+  unsigned long long total_steps = 0;
+  std::vector<double> means(table_groups);
+  for (unsigned int g = 0; g < table_groups; g++) {
+    _blocks->clear(_walker.get_seed(), g);
+    unsigned long long group_steps = 0;
+    for (unsigned long long i = 0; i < histories_per_group; i++) {
+      unsigned long long walk_num_steps = walk_history();
+      if (!_walker.at_coordinate(goal)) {
+        return set_aborted(g*histories_per_group + i);
+      }
+      PERF_COUNT(++util::perf_counters()._histories);
+      PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
+      group_steps += walk_num_steps;
+    }
+    total_steps += group_steps;
+    means[g] = static_cast<double>(group_steps) / histories_per_group;
+  }
+  double mean = std::accumulate(means.begin(), means.end(), 0.0) /
+    table_groups;
+  double sum_sq = 0;
+  for (double m : means) { sum_sq += (m-mean)*(m-mean); }
+  return set_results(
+    total_steps, static_cast<double>(table_groups)*histories_per_group,
+    mean, sum_sq / (table_groups*(table_groups-1.0)));
+}
+
+double MCWalk::walk_sobol(double num_samples) {
+  util::RNG & rng = _walker.get_rng();
+  util::Sobol sobol(_sobol_dimensions);
+  const unsigned long long points_per_randomization =
+    std::ceil(num_samples/_randomizations);
+  const auto goal = _grid->get_goal();
+  unsigned long long total_steps = 0;
+  std::vector<double> means(_randomizations);
+  for (unsigned int r = 0; r < _randomizations; r++) {
+    sobol.randomize(rng);
+    unsigned long long randomization_steps = 0;
+    for (unsigned long long i = 0; i < points_per_randomization; i++) {
+      // The point drives the first decisions, the engine the rest
+      const std::vector<double> & point = sobol.next();
+      rng.drive(point.data(), point.size());
+      unsigned long long walk_num_steps = walk_history();
+      rng.drive(nullptr, 0);
+      if (!_walker.at_coordinate(goal)) {
+        return set_aborted(r*points_per_randomization + i);
+      }
+      PERF_COUNT(++util::perf_counters()._histories);
+      PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
+      randomization_steps += walk_num_steps;
+    }
+    total_steps += randomization_steps;
+    means[r] = static_cast<double>(randomization_steps) /
+      points_per_randomization;
+  }
+  // The randomizations are independent estimates of the mean
+  double mean = std::accumulate(means.begin(), means.end(), 0.0) /
+    _randomizations;
+  double sum_sq = 0;
+  for (double m : means) { sum_sq += (m-mean)*(m-mean); }
+  return set_results(
+    total_steps, static_cast<double>(_randomizations)*points_per_randomization,
+    mean, sum_sq / (_randomizations*(_randomizations-1.0)));
+}
+
+// A history stopped before the goal at c steps is right censored, only
+// T > c is known. Under an exponential model of the number of steps T the
+// maximum likelihood mean is the total steps S of all n histories over the
+// number d reaching the goal, and its variance follows from linearizing the
+// ratio, sum_i (t_i - R*g_i)^2 / d^2 with g_i 1 for histories reaching the
+// goal and 0 otherwise. A history in progress at the deadline is kept as
+// censored, dropping it would favor short histories.
+double MCWalk::walk_budgeted(double num_samples) {
+  const auto start = std::chrono::steady_clock::now();
+  _has_deadline = _budget._seconds > 0;
+  _deadline = start + std::chrono::duration_cast<
+    std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(_budget._seconds));
+  _cut_short = false;
+  _num_histories = 0;
+  _num_censored = 0;
+  const auto goal = _grid->get_goal();
+  unsigned long long total_steps = 0;
+  unsigned long long goal_steps = 0;
+  double sum_sq_steps = 0;
+  const unsigned long long total = num_samples;
+  for (unsigned long long i = 0; i < total && !_cut_short; i++) {
+    if (_budget._steps > 0) {
+      if (total_steps >= _budget._steps) {
+        _cut_short = true;
+        break;
+      }
+      _step_limit = std::min<double>(
+        _max_steps, _budget._steps - total_steps);
+    }
+    // Every walk gets at least one history
+    if (i > 0 && _has_deadline &&
+        std::chrono::steady_clock::now() >= _deadline) {
+      _cut_short = true;
+      break;
+    }
+    unsigned long long walk_num_steps = walk_history();
+    PERF_COUNT(++util::perf_counters()._histories);
+    PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
+    ++_num_histories;
+    total_steps += walk_num_steps;
+    sum_sq_steps += static_cast<double>(walk_num_steps)*walk_num_steps;
+    if (_walker.at_coordinate(goal)) { goal_steps += walk_num_steps; }
+    else { ++_num_censored; }
+  }
+  _has_deadline = false;
+  _step_limit = _max_steps;
+  if (_verbose && (_cut_short || _num_censored > 0)) {
+    std::cout << "Budgeted walk stopped after " << _num_histories;
+    std::cout << " histories, " << _num_censored << " censored" << std::endl;
+  }
+
+  const unsigned long long num_goal = _num_histories - _num_censored;
+  if (num_goal == 0) {
+    // Every history was censored, so the steps per history only bound the
+    // mean from below and the error is unknown
+    if (_track_grid) { _grid->resolve_paths(); }
+    _num_steps = _num_histories > 0 ?
+      static_cast<double>(total_steps) / _num_histories : 0.0;
+    _mean = _num_steps;
+    _mean_var = std::numeric_limits<double>::quiet_NaN();
+    _FOM = 0.0;
+    return _mean;
+  }
+  double mean = static_cast<double>(total_steps) / num_goal;
+  double mean_var = std::max(0.0,
+    sum_sq_steps - 2*mean*goal_steps + mean*mean*num_goal) /
+    (static_cast<double>(num_goal)*num_goal);
+  return set_results(total_steps, _num_histories, mean, mean_var);
+}
+
 double MCWalk::walk_grid(double num_samples) {
+  if (_budgeted) {
+    if (_sampling != util::sampling::random_sampling) {
+      throw std::runtime_error(
+        "Budgeted walks only support pseudorandom sampling");
+    }
+    // Block jumps would overshoot the step limits of the budget
+    if (_blocks) {
+      throw std::runtime_error("Budgeted walks need the analog engine");
+    }
+    return walk_budgeted(num_samples);
+  }
+  if (_sampling != util::sampling::random_sampling) {
+    if (_blocks) {
+      throw std::runtime_error(
+        "The block engine only supports pseudorandom sampling");
+    }
+    return _sampling == util::sampling::antithetic_sampling ?
+      walk_antithetic(num_samples) : walk_sobol(num_samples);
+  }
+  if (_blocks && !_track_grid && !_recorder) {
+    return walk_table_groups(num_samples);
+  }
   // Accumulator for the first moment of the analog number of steps to the
   // goal
-  unsigned int goal_num_steps = 0;
+  unsigned long long goal_num_steps = 0;
   // Accumulator for the first moment of the weighted number of steps to the
   // goal
   double goal_m1 = 0;
@@ -18,21 +296,10 @@ double MCWalk::walk_grid(double num_samples) {
   double goal_m2 = 0;
   // Walk the grid
   for (unsigned int i = 0; i < num_samples; i++) {
-    // Reset the weight of the walker each time through the grid
-    // [no longer used, importance sampling commented out]
-    _walker.reset_weight();
-    // Start with zero steps at the start node
-    int walk_num_steps = 0;
-    _walker.set_position(_grid->get_start());
-    if (_track_grid) { _walker.visit_grid(_grid); }
+    unsigned long long walk_num_steps = walk_history();
     auto goal = _grid->get_goal();
-
-    // Walk until the goal is reached or the max number of steps is met
-    while (!_walker.at_coordinate(goal) && walk_num_steps < _max_steps) {
-      _walker.step(_grid);
-      if (_track_grid) { _walker.visit_grid(_grid); }
-      ++walk_num_steps;
-    }
+    PERF_COUNT(++util::perf_counters()._histories);
+    PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
 
     // Check how the walk eneded
     if (_walker.at_coordinate(goal)) {
@@ -43,16 +310,13 @@ double MCWalk::walk_grid(double num_samples) {
       goal_m2 += weighted_steps*weighted_steps;
     }
     else {
-      // If the max steps stop and returns a mean of the max allowed steps
-      std::cout << "Max number of steps exceeded on sample " << i << std::endl;
-      _num_steps = _max_steps;
-      _mean = _max_steps;
-      _mean_var = 0.0;
-      _FOM = 0.0;
-      return _mean;
+      return set_aborted(i);
     }
   }
 
+  // Add the path tally of the walk to the visits
+  if (_track_grid) { _grid->resolve_paths(); }
+
   // Average the number of steps
   _num_steps = goal_num_steps / num_samples;
   // Average the analog number of steps
@@ -71,12 +335,94 @@ double MCWalk::walk_grid(double num_samples) {
   return _mean;
 }
 
+bool MCWalk::walk_reweighted(
+    double num_samples, util::LikelihoodRatios & ratios) {
+  if (_blocks || _budgeted || _sampling != util::sampling::random_sampling) {
+    throw std::runtime_error(
+      "Only unbudgeted step by step walks with pseudorandom sampling can be "
+      "reweighted");
+  }
+  const auto goal = _grid->get_goal();
+  unsigned long long total_steps = 0;
+  double goal_m1 = 0;
+  double goal_m2 = 0;
+  const unsigned long long total = num_samples;
+  _ratios = &ratios;
+  for (unsigned long long i = 0; i < total; i++) {
+    unsigned long long walk_num_steps = walk_history();
+    PERF_COUNT(++util::perf_counters()._histories);
+    PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
+    if (!_walker.at_coordinate(goal)) {
+      _ratios = nullptr;
+      set_aborted(i);
+      return false;
+    }
+    ratios.end_history(walk_num_steps);
+    total_steps += walk_num_steps;
+    goal_m1 += walk_num_steps;
+    goal_m2 += static_cast<double>(walk_num_steps)*walk_num_steps;
+  }
+  _ratios = nullptr;
+  double mean = goal_m1 / total;
+  set_results(total_steps, total, mean,
+              (goal_m2 / total - mean*mean) / total);
+  return true;
+}
+
+util::WalkMoments MCWalk::walk_shard(
+    double num_samples, unsigned int shard, unsigned int num_shards) {
+  if (_blocks) {
+    throw std::runtime_error(
+      "The block engine shares tables between histories and cannot be "
+      "sharded");
+  }
+  if (_sampling != util::sampling::random_sampling) {
+    throw std::runtime_error(
+      "Only pseudorandom sampling can be sharded");
+  }
+  util::WalkMoments moments;
+  const unsigned long long total = num_samples;
+  const unsigned long long num_chunks =
+    (total + history_chunk_size - 1) / history_chunk_size;
+  const auto goal = _grid->get_goal();
+  for (unsigned long long c = shard; c < num_chunks && !moments._aborted;
+       c += num_shards) {
+    _walker.reset_stream(c);
+    unsigned long long end = std::min(total, (c+1)*history_chunk_size);
+    for (unsigned long long i = c*history_chunk_size; i < end; i++) {
+      unsigned long long walk_num_steps = walk_history();
+      PERF_COUNT(++util::perf_counters()._histories);
+      PERF_COUNT(util::perf_counters()._steps += walk_num_steps);
+      if (!_walker.at_coordinate(goal)) {
+        if (_verbose) {
+          std::cout << "Max number of steps exceeded on sample " << i;
+          std::cout << std::endl;
+        }
+        moments._aborted = true;
+        break;
+      }
+      moments.add(walk_num_steps);
+    }
+  }
+  if (_track_grid) { _grid->resolve_paths(); }
+  set_results(moments);
+  return moments;
+}
+
+void MCWalk::set_results(const util::WalkMoments & moments) {
+  _mean = moments.mean(_max_steps);
+  _num_steps = _mean;
+  _mean_var = moments.mean_variance();
+  _FOM = (_num_steps > 0 && _mean_var > 0) ?
+    1.0/(_num_steps*_mean_var) : 0.0;
+}
+
 void MCWalk::print_results() const {
   std::cout << std::fixed;
 	std::cout << std::showpoint;
 	std::cout << std::setprecision(5);
-  std::cout << "mean:  " << std::setw(8) << _mean << std::endl;
-  std::cout << "error: " << std::setw(8) << std::sqrt(_mean_var) << std::endl;
-  std::cout << "FOM:   " << std::setw(8) << _FOM << std::endl;
+  std::cout << "mean:  " << std::setw(8) << _mean << "\n";
+  std::cout << "error: " << std::setw(8) << std::sqrt(_mean_var) << "\n";
+  std::cout << "FOM:   " << std::setw(8) << _FOM << "\n";
 }
 
@@ -1,11 +1,28 @@
 #ifndef __MC_WALK_HEADER__
 #define __MC_WALK_HEADER__
 
+#include "block_tables.hpp"
 #include "util/grid.hpp"
+#include "util/likelihood_ratio.hpp"
+#include "util/sobol.hpp"
+#include "util/trajectory_file.hpp"
+#include "util/walk_moments.hpp"
 #include "walker.hpp"
 
+#include <chrono>
 #include <cmath>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Limits on the work of a single case, 0 for no limit
+struct WalkBudget {
+  // Wall clock seconds
+  double _seconds = 0;
+  // Total steps of all histories
+  unsigned long long _steps = 0;
+};
 
 // Class governing Monte Carlo random walk through the grid
 class MCWalk {
@@ -16,6 +33,23 @@ private:
   Walker _walker;
   // Whether of not to update visits on the grid as walk progresses
   bool _track_grid;
+  // Whether tracked walks tally every node traversed or only step endpoints
+  bool _path_tally = false;
+  // Whether or not to report walks exceeding the max number of steps
+  bool _verbose = true;
+  // Records every move of every history, null when not recording, not owned
+  util::TrajectoryWriter * _recorder = nullptr;
+  // Weights every step for the targets of walk_reweighted, null otherwise,
+  // not owned
+  util::LikelihoodRatios * _ratios = nullptr;
+  // Exit tables of the block engine, null for the analog step by step engine
+  std::unique_ptr<BlockTables> _blocks;
+  // How histories sample their decisions
+  util::sampling _sampling = util::sampling::random_sampling;
+  // Number of leading decisions of each history drawn from Sobol points
+  unsigned int _sobol_dimensions = 0;
+  // Number of independent randomizations of the Sobol points
+  unsigned int _randomizations = 0;
   // Average number of steps taken to goal
   double _num_steps = 0;
   // Estimate of the mean number of analog steps to goal
@@ -25,12 +59,64 @@ private:
   // Figure of merit of the simulation
   double _FOM = 0;
   // Hard coded bail out number of steps for impossible walks
-  const double _max_steps = 100000;
+  const double _max_steps = max_walk_steps;
+  // Number of steps after which the current history is abandoned
+  double _step_limit = max_walk_steps;
+  // Whether walks are budgeted, censoring histories rather than aborting
+  bool _budgeted = false;
+  // Limits of each budgeted walk
+  WalkBudget _budget;
+  // Deadline of the current budgeted walk, if it has a wall clock limit
+  std::chrono::steady_clock::time_point _deadline;
+  bool _has_deadline = false;
+  // Whether the last budgeted walk stopped before walking every history
+  bool _cut_short = false;
+  // Number of histories walked by the last budgeted walk, and how many of
+  // them were censored before reaching the goal
+  unsigned long long _num_histories = 0;
+  unsigned long long _num_censored = 0;
+  // Number of steps between checks of the deadline within a history
+  static const unsigned int deadline_interval = 4096;
+
+  // Walks a single history from the start until the goal is reached or the
+  // max number of steps is met, returns the number of steps taken
+  unsigned long long walk_history();
+  // Walks num_samples histories within the budget, see set_budget
+  double walk_budgeted(double num_samples);
+
+  // Walks num_samples histories with the block engine split across
+  // table_groups groups, each with its own tables
+  double walk_table_groups(double num_samples);
+
+  // Walks num_samples histories as antithetic pairs, the second history of
+  // each pair using 1-u for every number u of the first
+  double walk_antithetic(double num_samples);
+
+  // Walks num_samples histories split across the randomizations of a
+  // randomized Sobol sequence
+  double walk_sobol(double num_samples);
+
+  // Sets the results from the steps of the walked histories and the
+  // variance of the mean, returns the mean
+  double set_results(
+    unsigned long long total_steps, double num_histories, double mean,
+    double mean_var);
+
+  // Sets the results of a walk abandoned after the max number of steps
+  double set_aborted(unsigned long long sample);
+
   // Lowest acceptable weight
   // [no longer used, importance sampling commented out]
   const double _min_wight = 1e-7;
 
 public:
+  // Number of steps after which a history is abandoned
+  static constexpr double max_walk_steps = 100000;
+
+  // Number of independent groups of tables of the block engine, see
+  // set_block_engine
+  static const unsigned int table_groups = 8;
+
   MCWalk(Grid * grid, bool track_grid = false)
     : _grid(grid), _track_grid(track_grid) {};
   ~MCWalk() {};
@@ -38,12 +124,39 @@ public:
   // Prepares for a repeated walk
   void reset() {
     _walker.reset();
+    if (_blocks) { _blocks->clear(_walker.get_seed()); }
+    _cut_short = false;
+    _num_histories = 0;
+    _num_censored = 0;
     _num_steps = 0;
     _mean = 0;
     _mean_var = 0;
     _FOM = 0;
   }
 
+  // Set the seed of the walker RNG, applied by the next reset
+  void set_seed(double seed) { _walker.set_seed(seed); }
+
+  // Return the seed of the walker RNG
+  double get_seed() const { return _walker.get_seed(); }
+
+  // Return true if visits are tallied on the grid
+  bool tracks_grid() const { return _track_grid; }
+
+  // Set whether tracked walks tally every node traversed by each step
+  // rather than only the node each step ends at
+  void set_path_tally(bool path_tally) { _path_tally = path_tally; }
+
+  // Record every move of every history walked with recorder,
+  // null to stop recording. Like walks tallying visits, recorded walks step
+  // exactly rather than with the block engine.
+  void set_recorder(util::TrajectoryWriter * recorder) {
+    _recorder = recorder;
+  }
+
+  // Set whether walks exceeding the max number of steps are reported
+  void set_verbose(bool verbose) { _verbose = verbose; }
+
   // Set the PMF to biased values
   // Probabilities are assumed to be set in the following order:
   // [direction PMF] [distance PMF]
@@ -52,15 +165,126 @@ public:
   // south, south_west, west, north_west
   void set_biased_PMF(const std::vector<double> &probabilities) {
     _walker.set_biased_PMF(probabilities);
+    if (_blocks) { _blocks->clear(_walker.get_seed()); }
+  }
+
+  // Use the block engine, jumping between blocks of block_size nodes per side
+  // by sampling tables of table_samples local walks, filled by the first
+  // walkers leaving each node, and stepping exactly within exact_radius blocks
+  // of the goal. Walks tallying visits on the grid always step exactly.
+  // Histories sharing tables are correlated, so the histories of a walk are
+  // split across table_groups groups, each filling its own tables, and the
+  // error is the spread of the means of the groups. The bias of tables of
+  // finitely many local walks is not part of the error, see README.md.
+  void set_block_engine(
+      unsigned int block_size, unsigned int table_samples,
+      unsigned int exact_radius = 1) {
+    _blocks = std::make_unique<BlockTables>(
+      _grid, block_size, table_samples, exact_radius);
+    _blocks->clear(_walker.get_seed());
+  }
+
+  // Sample histories with pseudorandom numbers, the default, as antithetic
+  // pairs, or with the first dimensions decisions of each history (two per
+  // step, direction then distance) drawn from a Sobol sequence randomized
+  // randomizations times. The error of the Sobol mode is the spread of the
+  // means of the randomizations. Only walk_grid supports the other modes.
+  void set_sampling(
+      util::sampling sampling, unsigned int dimensions = 0,
+      unsigned int randomizations = 0) {
+    if (sampling == util::sampling::sobol_sampling &&
+        (dimensions == 0 || dimensions > util::Sobol::max_dimensions ||
+         randomizations < 2)) {
+      throw std::runtime_error(
+        "Sobol sampling requires 1 to "+
+        std::to_string(util::Sobol::max_dimensions)+
+        " dimensions and at least 2 randomizations");
+    }
+    _sampling = sampling;
+    _sobol_dimensions = dimensions;
+    _randomizations = randomizations;
+  }
+
+  // Budget every walk, stopping once either limit of budget is reached and
+  // returning the estimate of the histories walked so far. Histories cut off
+  // by a limit or by the max number of steps are censored rather than
+  // aborting the walk, and the mean is the censored exponential estimate,
+  // the total steps of every history over the number reaching the goal,
+  // which is the plain mean when no history is censored, though its error
+  // is that of the ratio. A walk with no history reaching the goal returns
+  // the steps per history, a lower bound of the mean, with a NaN error.
+  // Only analog walks with pseudorandom sampling can be budgeted.
+  void set_budget(const WalkBudget & budget) {
+    if (!(budget._seconds >= 0)) {
+      throw std::runtime_error("Budget seconds must not be negative");
+    }
+    _budget = budget;
+    _budgeted = true;
   }
 
+  // Return true if walks are budgeted
+  bool is_budgeted() const { return _budgeted; }
+
+  // Return true if the last budgeted walk stopped at a limit of its budget
+  bool cut_short() const { return _cut_short; }
+
+  // Return the number of histories walked by the last budgeted walk
+  unsigned long long get_num_histories() const { return _num_histories; }
+
+  // Return the number of histories of the last budgeted walk censored
+  // before reaching the goal
+  unsigned long long get_num_censored() const { return _num_censored; }
+
   // Perform Monte Carlo random walk on the grid num_samples times and return
   // the average number of steps taken to get to the goal per history
   double walk_grid(double num_samples = 1e7);
 
+  // Walk num_samples histories with the PMF of the walker, weighting each
+  // step for every target PMF of ratios, see util::LikelihoodRatios. Sets
+  // the results to those of the walker PMF. Only unbudgeted step by step
+  // walks with pseudorandom sampling can be reweighted. Returns false if a
+  // history exceeded the max number of steps, leaving the estimates of every
+  // target incomplete.
+  bool walk_reweighted(double num_samples, util::LikelihoodRatios & ratios);
+
+  // Number of histories sharing each RNG substream of walk_shard
+  static const unsigned long long history_chunk_size = 4096;
+
+  // Walk the histories of one shard of num_samples histories split into
+  // chunks of history_chunk_size, each walked with its own RNG substream.
+  // Shard i of n walks chunks i, i+n, i+2n, ... so the moments of all shards
+  // merge into exactly the moments of shard 0 of 1. Sets the results to the
+  // moments of the shard and returns them.
+  util::WalkMoments walk_shard(
+    double num_samples, unsigned int shard, unsigned int num_shards);
+
+  // Set the results from the moments of a set of histories
+  void set_results(const util::WalkMoments & moments);
+
+  // Return the max number of steps of a history
+  double get_max_steps() const { return _max_steps; }
+
   // Prints the return of get_estimate as well as the figure of merit
   void print_results() const;
 
+  // Return the estimate of the mean number of steps of the last walk
+  double get_mean() const { return _mean; }
+
+  // Return the standard deviation of the mean of the last walk
+  double get_error() const { return std::sqrt(_mean_var); }
+
+  // Return the figure of merit of the last walk
+  double get_FOM() const { return _FOM; }
+
+  // Set the results of the last walk without walking, used when a walk with
+  // the same inputs is already known
+  void set_results(double mean, double error, double FOM) {
+    _mean = mean;
+    _num_steps = mean;
+    _mean_var = error*error;
+    _FOM = FOM;
+  }
+
   // Print the PMF paramters of teh walker
   void print_walker() const { _walker.print_PMF_paramters(); }
 };
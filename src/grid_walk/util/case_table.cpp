@@ -0,0 +1,45 @@
+#include "case_table.hpp"
+
+#include <algorithm>
+
+// Utility namespace
+namespace util {
+
+// Parameter columns move to their offsets of the new capacity
+void CaseTable::reserve(size_t capacity) {
+  if (capacity <= _capacity) { return; }
+  std::vector<double> params(capacity*num_PMF_params);
+  for (int j = 0; j < num_PMF_params; j++) {
+    std::copy(_params.begin() + j*_capacity,
+              _params.begin() + j*_capacity + _size,
+              params.begin() + j*capacity);
+  }
+  _params.swap(params);
+  _means.resize(capacity);
+  _errors.resize(capacity);
+  _samples.resize(capacity);
+  _runtimes.resize(capacity);
+  _capacity = capacity;
+}
+
+size_t CaseTable::append(const CaseResult & result) {
+  if (_size == _capacity) { reserve(std::max<size_t>(16, 2*_capacity)); }
+  for (int j = 0; j < num_PMF_params; j++) {
+    _params[j*_capacity + _size] = result._params[j];
+  }
+  _means[_size] = result._mean;
+  _errors[_size] = result._error;
+  _samples[_size] = result._samples;
+  _runtimes[_size] = result._runtime;
+  return _size++;
+}
+
+void CaseTable::get(size_t i, CaseResult & result) const {
+  get_params(i, result._params);
+  result._mean = _means[i];
+  result._error = _errors[i];
+  result._samples = _samples[i];
+  result._runtime = _runtimes[i];
+}
+
+} // end namespace util
@@ -0,0 +1,70 @@
+#ifndef __CASE_TABLE_HEADER__
+#define __CASE_TABLE_HEADER__
+
+#include "results_writer.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Parameters and results of many cases stored column by column, each
+// parameter and statistic of every case in one contiguous array. Once
+// reserved, cases are appended without allocating, and a statistic of every
+// case is scanned without touching the others. Cases are read and written
+// as CaseResult records.
+class CaseTable {
+private:
+  // Parameter j of case i at _params[j*_capacity + i]
+  std::vector<double> _params;
+  std::vector<double> _means;
+  std::vector<double> _errors;
+  std::vector<double> _samples;
+  std::vector<double> _runtimes;
+  size_t _size = 0;
+  size_t _capacity = 0;
+
+public:
+  CaseTable() {};
+  ~CaseTable() {};
+
+  // Make room for capacity cases, keeping those already stored
+  void reserve(size_t capacity);
+
+  // Number of cases stored
+  size_t size() const { return _size; }
+
+  // True if no case is stored
+  bool empty() const { return _size == 0; }
+
+  // Remove every case, keeping the storage
+  void clear() { _size = 0; }
+
+  // Append a case, doubling the capacity if full, returns its index
+  size_t append(const CaseResult & result);
+
+  // Return parameter j of case i
+  double param(size_t i, int j) const { return _params[j*_capacity + i]; }
+
+  // Writes the num_PMF_params parameters of case i to params
+  void get_params(size_t i, double * params) const {
+    for (int j = 0; j < num_PMF_params; j++) { params[j] = param(i, j); }
+  }
+
+  // Writes case i to result
+  void get(size_t i, CaseResult & result) const;
+
+  // Return the estimate of the mean number of steps of case i
+  double mean(size_t i) const { return _means[i]; }
+
+  // Return the standard deviation of the estimate of the mean of case i
+  double error(size_t i) const { return _errors[i]; }
+
+  // Return the mean number of steps of every case
+  const double * means() const { return _means.data(); }
+};
+
+} // end namespace util
+
+#endif
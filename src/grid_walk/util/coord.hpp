@@ -10,11 +10,10 @@ struct Coord {
   // x and y coordinates
   unsigned int _x_coord = 0;
   unsigned int _y_coord = 0;
-  Coord(unsigned int x, unsigned int y) : _x_coord(x), _y_coord(y) {};
-  Coord(const Coord & other_coord)
+  constexpr Coord(unsigned int x, unsigned int y) : _x_coord(x), _y_coord(y) {};
+  constexpr Coord(const Coord & other_coord)
     : _x_coord(other_coord._x_coord), _y_coord(other_coord._y_coord) {};
-  Coord() {};
-  ~Coord() {};
+  constexpr Coord() {};
 
   bool operator==(const Coord &c) const {
     return ((c._x_coord == _x_coord) && (c._y_coord == _y_coord));
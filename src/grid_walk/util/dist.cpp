@@ -9,53 +9,6 @@ static const double pi = 3.14159265358979323846;
 // Utility namespace
 namespace util {
 
-// Recall input format
-// (x,y)-->
-//  |  .
-//  V    .
-// Returns coordinate pair corresponding to the x and y increments of the
-// direction
-util::Coord to_increment(direction dir) {
-  unsigned int x,y;
-  switch (dir) {
-    case north:
-      x =  0;
-      y =  -1;
-      break;
-    case north_east:
-      x =  1;
-      y =  -1;
-      break;
-    case east:
-      x =  1;
-      y =  0;
-      break;
-    case south_east:
-      x =  1;
-      y =  1;
-      break;
-    case south:
-      x =  0;
-      y =  1;
-      break;
-    case south_west:
-      x = -1;
-      y =  1;
-      break;
-    case west:
-      x = -1;
-      y =  0;
-      break;
-    case north_west:
-      x = -1;
-      y = -1;
-      break;
-    default:
-      throw std::runtime_error("Unknown direction to step in");
-  }
-  return util::Coord(x,y);
-}
-
 // continuous truncated exponential PDF given by:
 // lambda*exp(-lambda*(x-a))/(1-exp(-lambda*(b-a))); 0<=x<=b
 unsigned int PDF::sample(
@@ -82,17 +35,21 @@ double PDF::evaluate(
 // Probabilities is assumed to be strictly positive
 unsigned int PDF::sample(
     const std::vector<double> &probabilities, dist_type type) const {
+  return sample(probabilities.data(), probabilities.size(), type);
+}
+unsigned int PDF::sample(
+    const double * probabilities, size_t n, dist_type type) const {
   double stop = _rng.sample();
   double total = std::accumulate(
-    probabilities.begin(), probabilities.end(), 0.0, std::plus<double>());
-  for (size_t i = 0; i < probabilities.size(); i++) {
+    probabilities, probabilities+n, 0.0, std::plus<double>());
+  for (size_t i = 0; i < n; i++) {
     stop -= probabilities[i]/total;
     if (stop <= 0) {
       return i;
     }
   }
   // Maybe exit loop on floating point roundoff error
-  return probabilities.size()-1;
+  return n-1;
 }
 double PDF::evaluate(
     const std::vector<double> &probabilities, const unsigned int idx,
@@ -106,16 +63,22 @@ double PDF::evaluate(
 std::vector<double> PDF::sample(
     const std::vector<double> & means, const double std_1, const double std_2,
     dist_type type) const {
-  std::vector<double> samples;
-  for (int i = 0; i < means.size()-1; i++) {
-    samples.push_back(
+  std::vector<double> samples(means.size());
+  sample(means.data(), means.size(), std_1, std_2, samples.data(), type);
+  return samples;
+}
+
+void PDF::sample(
+    const double * means, size_t n, const double std_1, const double std_2,
+    double * samples, dist_type type) const {
+  for (size_t i = 0; i+1 < n; i++) {
+    samples[i] =
       means[i] + std_1*std::sqrt(-2*std::log(_rng.sample()))
-                  *std::cos(2*pi*_rng.sample()));
+                  *std::cos(2*pi*_rng.sample());
   }
-  samples.push_back(
-      means.back() + std_2*std::sqrt(-2*std::log(_rng.sample()))
-                     *std::cos(2*pi*_rng.sample()));
-  return std::move(samples);
+  samples[n-1] =
+      means[n-1] + std_2*std::sqrt(-2*std::log(_rng.sample()))
+                   *std::cos(2*pi*_rng.sample());
 }
 
 } // end namespace util
\ No newline at end of file
@@ -2,8 +2,10 @@
 #define __PDF_HEADER__
 
 #include "coord.hpp"
+#include "lattice.hpp"
 #include "rand.hpp"
 
+#include <array>
 #include <utility>
 #include <vector>
 
@@ -18,15 +20,24 @@ enum dist_type {truncated_exponential, categorical, guassian, uniform};
 enum direction {north, north_east, east, south_east,
                 south, south_west, west, north_west};
 
-// Vector of direction enum for safe iteration
-static const std::vector<direction> all_directions = {
-  direction::north, direction::north_east,
-  direction::east, direction::south_east,
-  direction::south, direction::south_west,
-  direction::west, direction::north_west};
+// Array of direction enum for safe iteration
+static constexpr std::array<direction, Lattice<2>::num_directions>
+  all_directions = {
+    direction::north, direction::north_east,
+    direction::east, direction::south_east,
+    direction::south, direction::south_west,
+    direction::west, direction::north_west};
 
 // Returns coordinate with x, y increments corresponding to a given direction
-util::Coord to_increment(direction dir);
+// Recall input format
+// (x,y)-->
+//  |  .
+//  V    .
+// Negative increments wrap around the unsigned coordinates
+constexpr util::Coord to_increment(direction dir) {
+  return util::Coord(Lattice<2>::increments[dir][0],
+                     Lattice<2>::increments[dir][1]);
+}
 
 // Class for all probability density distributions
 class PDF {
@@ -38,8 +49,16 @@ public:
   PDF(RNG rng) : _rng(rng) {};
   ~PDF() {};
 
-  // Returns the rng to the default state
-  void reset_rng() { _rng.set_seed(); }
+  // Returns the rng to the initial state of the passed seed
+  void reset_rng(double seed = 16180339) { _rng.set_seed(seed); }
+
+  // Returns the rng used for every sample
+  RNG & get_rng() const { return _rng; }
+
+  // Sets the rng to substream stream of the passed seed
+  void reset_rng(double seed, uint64_t stream) {
+    _rng.set_seed(seed, stream);
+  }
 
   // PDF is deduced by operator overloading or type enum
   // sample: samples a random point from the PDF
@@ -59,6 +78,10 @@ public:
   unsigned int sample(
     const std::vector<double> &probabilities,
     dist_type type = dist_type::categorical) const;
+  // Samples the n probabilities at probabilities without allocating
+  unsigned int sample(
+    const double * probabilities, size_t n,
+    dist_type type = dist_type::categorical) const;
   double evaluate(
     const std::vector<double> &probabilities, const unsigned int idx,
     dist_type type = dist_type::categorical) const;
@@ -68,6 +91,11 @@ public:
   std::vector<double> sample(
       const std::vector<double> & means, const double std_1,
       const double std_2, dist_type type = dist_type::guassian) const;
+  // Writes the n samples to samples without allocating, samples may alias
+  // means
+  void sample(
+      const double * means, size_t n, const double std_1, const double std_2,
+      double * samples, dist_type type = dist_type::guassian) const;
 
   // Sample PRNG [0,1]
   double sample(dist_type type = dist_type::uniform) {
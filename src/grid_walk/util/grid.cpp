@@ -1,5 +1,9 @@
 #include "grid.hpp"
 
+#include "hash.hpp"
+#include "perf_counters.hpp"
+
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
@@ -12,9 +16,13 @@ bool Grid::reachableNode(const util::Coord & coord) const {
            _nodes[coord._y_coord][coord._x_coord]._is_reachable;
 }
 
+// Magic string starting binary grid files
+static const std::string binary_magic = "GWGRID1";
+
 // Parse input file for grid, start, and goal specification
 // Note zero based indexing is used
-// File Format:
+// Files starting with the binary magic string are read with read_binary
+// Text File Format:
 // dimensions [row_length] [num_rows]
 // start [x_index_of_start_node] [y_index_of_start_node]
 // goal [x_index_of_goal_node] [y_index_of_goal_node]
@@ -23,12 +31,17 @@ bool Grid::reachableNode(const util::Coord & coord) const {
 //   .   . .   .
 // [0/1] . . [0/1]
 // Grid of 1s of 0s denoting whether node is reachable or not
-Grid::Grid(std::ifstream & input_file) {
+Grid::Grid(std::istream & input_file) {
   // Read in junk ("dimensions", "start", and "goal") to junk variable
   std::string junk;
   int x, y;
+  input_file >> junk;
+  if (junk == binary_magic) {
+    read_binary(input_file);
+    return;
+  }
   // Read in grid dimensions
-  input_file >> junk >> _x_dim >> _y_dim;
+  input_file >> _x_dim >> _y_dim;
   // Read in start 
   input_file >> junk >> x >> y;
   _start = util::Coord(x,y);
@@ -49,31 +62,340 @@ Grid::Grid(std::ifstream & input_file) {
     }
     _nodes.push_back(row);
   }
+  build_run_lengths();
+}
+
+// Build the grid row by row from the reachability of each node
+Grid::Grid(unsigned int x_dim, unsigned int y_dim, util::Coord start,
+           util::Coord goal, const std::vector<bool> & reachable)
+    : _x_dim(x_dim), _y_dim(y_dim), _start(start), _goal(goal) {
+  if (reachable.size() != static_cast<size_t>(x_dim)*y_dim) {
+    throw std::runtime_error("Grid reachability has the wrong size");
+  }
+  _nodes.reserve(_y_dim);
+  for (unsigned int j = 0; j < _y_dim; j++) {
+    std::vector<Node> row;
+    row.reserve(_x_dim);
+    for (unsigned int i = 0; i < _x_dim; i++) {
+      row.push_back(Node(reachable[static_cast<size_t>(j)*_x_dim+i]));
+    }
+    _nodes.push_back(row);
+  }
+  build_run_lengths();
+}
+
+// Reads a little endian unsigned 32 bit integer
+static unsigned int read_uint(std::istream & input_file) {
+  unsigned char bytes[4];
+  input_file.read(reinterpret_cast<char *>(bytes), 4);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+    (static_cast<unsigned int>(bytes[3]) << 24);
+}
+
+// Writes a little endian unsigned 32 bit integer
+static void write_uint(std::ostream & output_file, unsigned int value) {
+  unsigned char bytes[4] = {
+    static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8),
+    static_cast<unsigned char>(value >> 16),
+    static_cast<unsigned char>(value >> 24)};
+  output_file.write(reinterpret_cast<const char *>(bytes), 4);
+}
+
+// Binary File Format, following the magic string and a newline:
+// [x_dim] [y_dim] [start_x] [start_y] [goal_x] [goal_y]
+// as little endian unsigned 32 bit integers, followed by the reachability of
+// each node row by row packed 8 nodes per byte, least significant bit first
+void Grid::read_binary(std::istream & input_file) {
+  input_file.get();
+  _x_dim = read_uint(input_file);
+  _y_dim = read_uint(input_file);
+  unsigned int x = read_uint(input_file);
+  unsigned int y = read_uint(input_file);
+  _start = util::Coord(x,y);
+  x = read_uint(input_file);
+  y = read_uint(input_file);
+  _goal = util::Coord(x,y);
+
+  size_t num_nodes = static_cast<size_t>(_x_dim)*_y_dim;
+  std::vector<unsigned char> packed((num_nodes+7)/8);
+  input_file.read(reinterpret_cast<char *>(packed.data()), packed.size());
+  if (!input_file) {
+    throw std::runtime_error("Binary grid file is truncated");
+  }
+  _nodes.assign(_y_dim, std::vector<Node>());
+  size_t idx = 0;
+  for (unsigned int j = 0; j < _y_dim; j++) {
+    _nodes[j].reserve(_x_dim);
+    for (unsigned int i = 0; i < _x_dim; i++, idx++) {
+      _nodes[j].push_back(Node((packed[idx/8] >> (idx%8)) & 1));
+    }
+  }
+  build_run_lengths();
+}
+
+// Each node in dir is one further from the end of its run than the next
+// node in dir, so nodes are visited against dir: rows against its y
+// increment, and within a row against its x increment
+void Grid::build_run_lengths() {
+  const size_t num_dirs = util::all_directions.size();
+  _run_lengths.assign(static_cast<size_t>(_x_dim)*_y_dim*num_dirs, 0);
+  _goal_connected = -1;
+  _goal_path.clear();
+  _hash_valid = false;
+  for (const auto dir : util::all_directions) {
+    const int dx = util::Lattice<2>::increments[dir][0];
+    const int dy = util::Lattice<2>::increments[dir][1];
+    for (unsigned int j = 0; j < _y_dim; j++) {
+      const unsigned int y = dy > 0 ? _y_dim-1-j : j;
+      for (unsigned int i = 0; i < _x_dim; i++) {
+        const unsigned int x = dx > 0 ? _x_dim-1-i : i;
+        const unsigned int next_x = x + dx;
+        const unsigned int next_y = y + dy;
+        if (next_x >= _x_dim || next_y >= _y_dim ||
+            !_nodes[next_y][next_x]._is_reachable) { continue; }
+        _run_lengths[run_index(x, y) + dir] = std::min<unsigned int>(
+          _run_lengths[run_index(next_x, next_y) + dir] + 1, max_run_length);
+      }
+    }
+  }
+}
+
+void Grid::update_run_lengths(long long x, long long y, util::direction dir) {
+  const long long dx = util::Lattice<2>::increments[dir][0];
+  const long long dy = util::Lattice<2>::increments[dir][1];
+  // Move to the last node of the line in dir, whose run is empty
+  long long steps = static_cast<long long>(_x_dim) + _y_dim;
+  if (dx > 0) { steps = std::min<long long>(steps, _x_dim-1-x); }
+  if (dx < 0) { steps = std::min<long long>(steps, x); }
+  if (dy > 0) { steps = std::min<long long>(steps, _y_dim-1-y); }
+  if (dy < 0) { steps = std::min<long long>(steps, y); }
+  x += dx*steps;
+  y += dy*steps;
+  uint16_t run = 0;
+  _run_lengths[run_index(x, y) + dir] = run;
+  for (x -= dx, y -= dy; x >= 0 && x < _x_dim && y >= 0 && y < _y_dim;
+       x -= dx, y -= dy) {
+    run = _nodes[y+dy][x+dx]._is_reachable ?
+      std::min<unsigned int>(run + 1, max_run_length) : 0;
+    _run_lengths[run_index(x, y) + dir] = run;
+  }
+}
+
+size_t Grid::set_reachable(
+    const util::Coord & first, const util::Coord & last, bool reachable) {
+  const unsigned int x0 = std::min(first._x_coord, last._x_coord);
+  const unsigned int x1 = std::max(first._x_coord, last._x_coord);
+  const unsigned int y0 = std::min(first._y_coord, last._y_coord);
+  const unsigned int y1 = std::max(first._y_coord, last._y_coord);
+  if (x1 >= _x_dim || y1 >= _y_dim) {
+    throw std::runtime_error("Nodes to change are outside the grid");
+  }
+  size_t num_changed = 0;
+  bool path_cut = false;
+  for (unsigned int y = y0; y <= y1; y++) {
+    for (unsigned int x = x0; x <= x1; x++) {
+      if (_nodes[y][x]._is_reachable == reachable) { continue; }
+      ++num_changed;
+      _nodes[y][x]._is_reachable = reachable;
+      path_cut = path_cut || (!_goal_path.empty() &&
+        _goal_path[static_cast<size_t>(y)*_x_dim + x]);
+    }
+  }
+  if (num_changed == 0) { return 0; }
+  _hash_valid = false;
+  // Opening nodes keeps a reachable goal reachable, and blocking nodes keeps
+  // an unreachable goal unreachable and a reachable goal reachable along the
+  // last path found unless a node of the path is blocked
+  if (reachable ? _goal_connected != 1 : path_cut) {
+    _goal_connected = -1;
+    _goal_path.clear();
+  }
+
+  // Every line through the rectangle crosses its border, so the lines are
+  // found from the border nodes, each line once. Lines in dir keep
+  // dy*x - dx*y constant.
+  const long long offset = static_cast<long long>(_x_dim) + _y_dim;
+  std::vector<bool> updated(2*offset+1);
+  for (const auto dir : util::all_directions) {
+    const long long dx = util::Lattice<2>::increments[dir][0];
+    const long long dy = util::Lattice<2>::increments[dir][1];
+    std::fill(updated.begin(), updated.end(), false);
+    auto update = [&](long long x, long long y) {
+      long long line = dy*x - dx*y + offset;
+      if (updated[line]) { return; }
+      updated[line] = true;
+      update_run_lengths(x, y, dir);
+    };
+    for (unsigned int x = x0; x <= x1; x++) {
+      update(x, y0);
+      update(x, y1);
+    }
+    for (unsigned int y = y0; y <= y1; y++) {
+      update(x0, y);
+      update(x1, y);
+    }
+  }
+  return num_changed;
+}
+
+// Write the grid in the same text or binary format read by the constructor
+void Grid::write(std::ostream & output_file, util::grid_format format) const {
+  if (format == util::grid_format::binary_grid) {
+    output_file << binary_magic << "\n";
+    write_uint(output_file, _x_dim);
+    write_uint(output_file, _y_dim);
+    write_uint(output_file, _start._x_coord);
+    write_uint(output_file, _start._y_coord);
+    write_uint(output_file, _goal._x_coord);
+    write_uint(output_file, _goal._y_coord);
+    size_t num_nodes = static_cast<size_t>(_x_dim)*_y_dim;
+    std::vector<unsigned char> packed((num_nodes+7)/8, 0);
+    size_t idx = 0;
+    for (unsigned int y = 0; y < _y_dim; y++) {
+      for (unsigned int x = 0; x < _x_dim; x++, idx++) {
+        if (_nodes[y][x]._is_reachable) { packed[idx/8] |= 1 << (idx%8); }
+      }
+    }
+    output_file.write(
+      reinterpret_cast<const char *>(packed.data()), packed.size());
+  }
+  else {
+    output_file << "dimensions " << _x_dim << " " << _y_dim << "\n";
+    output_file << "start " << _start._x_coord << " " << _start._y_coord;
+    output_file << "\ngoal " << _goal._x_coord << " " << _goal._y_coord;
+    std::string row(_x_dim > 0 ? 2*_x_dim-1 : 0, ' ');
+    for (unsigned int y = 0; y < _y_dim; y++) {
+      for (unsigned int x = 0; x < _x_dim; x++) {
+        row[2*x] = _nodes[y][x]._is_reachable ? '1' : '0';
+      }
+      output_file << "\n" << row;
+    }
+    output_file << "\n";
+  }
+  output_file.flush();
+}
+
+// Hash of the dimensions, start, goal, and reachability of every node
+uint64_t Grid::hash() const {
+  if (_hash_valid) { return _hash; }
+  unsigned int header[6] = {_x_dim, _y_dim, _start._x_coord,
+                            _start._y_coord, _goal._x_coord, _goal._y_coord};
+  uint64_t hash = util::fnv1a(header, sizeof(header));
+  for (const auto & row : _nodes) {
+    for (const auto & node : row) {
+      unsigned char reachable = node._is_reachable;
+      hash = util::fnv1a(&reachable, 1, hash);
+    }
+  }
+  _hash = hash;
+  _hash_valid = true;
+  return hash;
 }
 
 // Return all the possible directions of travel from current coordinate
 std::vector<util::direction> Grid::get_directions(
       const util::Coord & curr_coord) const {
   std::vector<util::direction> possible_dirs;
-  for (const auto dir : util::all_directions) {
-    auto incr = util::to_increment(dir);
-    if (reachableNode(curr_coord+incr)) {
-      possible_dirs.push_back(dir);
+  if (curr_coord._x_coord < _x_dim && curr_coord._y_coord < _y_dim) {
+    // Directions with a reachable neighbour have a run of at least one node
+    const uint16_t * runs =
+      &_run_lengths[run_index(curr_coord._x_coord, curr_coord._y_coord)];
+    for (const auto dir : util::all_directions) {
+      if (runs[dir] > 0) { possible_dirs.push_back(dir); }
+    }
+  }
+  else {
+    for (const auto dir : util::all_directions) {
+      auto incr = util::to_increment(dir);
+      if (reachableNode(curr_coord+incr)) {
+        possible_dirs.push_back(dir);
+      }
     }
   }
+  PERF_COUNT(++util::perf_counters()._num_directions[possible_dirs.size()]);
   return std::move(possible_dirs);
 }
 
+uint8_t Grid::get_direction_mask(const util::Coord & curr_coord) const {
+  uint8_t mask = 0;
+  if (curr_coord._x_coord < _x_dim && curr_coord._y_coord < _y_dim) {
+    const uint16_t * runs =
+      &_run_lengths[run_index(curr_coord._x_coord, curr_coord._y_coord)];
+    for (const auto dir : util::all_directions) {
+      if (runs[dir] > 0) { mask |= 1 << dir; }
+    }
+  }
+  else {
+    for (const auto dir : util::all_directions) {
+      if (reachableNode(curr_coord+util::to_increment(dir))) {
+        mask |= 1 << dir;
+      }
+    }
+  }
+  return mask;
+}
+
+// Breadth first search over the moves of a single node in any direction,
+// keeping the shortest path found so later changes off it need no search
+bool Grid::goal_reachable() const {
+  if (_goal_connected >= 0) { return _goal_connected; }
+  _goal_connected = 0;
+  _goal_path.clear();
+  // Direction each node was first reached in, 8 until reached
+  const uint8_t unseen = util::all_directions.size();
+  std::vector<uint8_t> reached_in(
+    static_cast<size_t>(_x_dim)*_y_dim, unseen);
+  auto index = [this](const util::Coord & coord) {
+    return static_cast<size_t>(coord._y_coord)*_x_dim + coord._x_coord;
+  };
+  std::vector<util::Coord> frontier = {_start};
+  reached_in[index(_start)] = util::north;
+  for (size_t head = 0; head < frontier.size(); head++) {
+    util::Coord coord = frontier[head];
+    if (coord == _goal) {
+      // Walk back from the goal against the direction each node was
+      // reached in, the opposite direction is four further clockwise
+      _goal_connected = 1;
+      _goal_path.assign(reached_in.size(), false);
+      for (; !(coord == _start); coord = coord + util::to_increment(
+             util::all_directions[(reached_in[index(coord)] + 4) % 8])) {
+        _goal_path[index(coord)] = true;
+      }
+      _goal_path[index(_start)] = true;
+      return true;
+    }
+    for (const auto dir : util::all_directions) {
+      util::Coord next = coord + util::to_increment(dir);
+      if (!reachableNode(next) || reached_in[index(next)] != unseen) {
+        continue;
+      }
+      reached_in[index(next)] = dir;
+      frontier.push_back(next);
+    }
+  }
+  return false;
+}
+
 // Return the number of contiguous nodes from coord in dir
 unsigned int Grid::get_distance(
     const util::Coord & coord, util::direction dir) const {
   unsigned int num_nodes = 0;
-  auto incr = util::to_increment(dir);
-  auto runner = coord + incr;
-  while(reachableNode(runner)) {
-    runner += incr;
-    ++num_nodes;
+  const bool inside = coord._x_coord < _x_dim && coord._y_coord < _y_dim;
+  if (inside) {
+    num_nodes = _run_lengths[run_index(coord._x_coord, coord._y_coord)+dir];
+  }
+  // Runs from outside the grid or longer than the stored run are counted
+  if (!inside || num_nodes == max_run_length) {
+    num_nodes = 0;
+    auto incr = util::to_increment(dir);
+    auto runner = coord + incr;
+    while(reachableNode(runner)) {
+      runner += incr;
+      ++num_nodes;
+    }
   }
+  PERF_COUNT(++util::perf_counters()._run_lengths[
+    std::min<unsigned int>(num_nodes, util::PerfCounters::max_run_length)]);
   return num_nodes;
 }
 
@@ -87,6 +409,62 @@ void Grid::visit(const util::Coord & coord) {
   }
 }
 
+// Difference array updates of a move, see _path_diffs. Moves are recorded
+// in increasing y order, or increasing x order for east-west moves, as a +1
+// at the first node traversed and a -1 just past the last node.
+void Grid::visit_path(
+    const util::Coord & coord, util::direction dir, unsigned int dist) {
+  if (dist == 0) { return; }
+  const size_t diffs_size = static_cast<size_t>(_x_dim+2)*(_y_dim+2);
+  if (_path_diffs.empty()) { _path_diffs.assign(4*diffs_size, 0); }
+  // Orientation of the move and whether it runs in increasing order
+  static const int orientation[8] = {1, 3, 0, 2, 1, 3, 0, 2};
+  static const bool increasing[8] =
+    {false, false, true, true, true, true, false, false};
+  util::Coord increment = util::to_increment(dir);
+  long long dx = static_cast<int>(increment._x_coord);
+  long long dy = static_cast<int>(increment._y_coord);
+  long long x = coord._x_coord;
+  long long y = coord._y_coord;
+  long long * diffs = _path_diffs.data() + orientation[dir]*diffs_size;
+  if (increasing[dir]) {
+    diffs[path_index(x - dx*(dist-1), y - dy*(dist-1))] += 1;
+    diffs[path_index(x + dx, y + dy)] -= 1;
+  }
+  else {
+    diffs[path_index(x, y)] += 1;
+    diffs[path_index(x - dx*dist, y - dy*dist)] -= 1;
+  }
+}
+
+void Grid::resolve_paths() {
+  if (_path_diffs.empty()) { return; }
+  const long long width = _x_dim+2;
+  const size_t diffs_size = static_cast<size_t>(width)*(_y_dim+2);
+  // Offset of the previous node in increasing order of each orientation
+  const long long previous[4] = {-1, -width, -width-1, -width+1};
+  for (int o = 0; o < 4; o++) {
+    long long * diffs = _path_diffs.data() + o*diffs_size;
+    for (long long y = 0; y < _y_dim+2; y++) {
+      for (long long x = 0; x < width; x++) {
+        long long idx = y*width + x;
+        long long prev = idx + previous[o];
+        // Previous nodes outside the padded array hold no paths
+        bool inside = (o == 0) ? x > 0 :
+                      (o == 1) ? y > 0 :
+                      (o == 2) ? x > 0 && y > 0 : x+1 < width && y > 0;
+        if (inside) { diffs[idx] += diffs[prev]; }
+      }
+    }
+    for (unsigned int y = 0; y < _y_dim; y++) {
+      for (unsigned int x = 0; x < _x_dim; x++) {
+        _nodes[y][x]._num_visits += diffs[path_index(x, y)];
+      }
+    }
+  }
+  std::fill(_path_diffs.begin(), _path_diffs.end(), 0);
+}
+
 // Set _num_visits to zero fot all nodes
 void Grid::clear_visits() {
   for (int y = 0; y < _y_dim; y++) {
@@ -94,17 +472,52 @@ void Grid::clear_visits() {
       _nodes[y][x]._num_visits = 0;
     }
   }
+  std::fill(_path_diffs.begin(), _path_diffs.end(), 0);
 }
 
 // Print the average number of visits per node
 void Grid::print(std::ostream & output_file, double num_walks) const {
-  std::cout << std::fixed;
-	std::cout << std::showpoint;
-	std::cout << std::setprecision(5);
+  output_file << std::fixed;
+	output_file << std::showpoint;
+	output_file << std::setprecision(5);
   for (int y = 0; y < _y_dim; y++) {
     for (int x = 0; x < _x_dim; x++) {
-      std::cout << std::setw(8) << _nodes[y][x]._num_visits / num_walks << " ";
+      output_file << std::setw(8) << _nodes[y][x]._num_visits / num_walks;
+      output_file << " ";
     }
-    std::cout << std::endl;
+    output_file << "\n";
   }
-}
\ No newline at end of file
+  output_file.flush();
+}
+
+void Grid::add_visits(std::vector<uint64_t> & counts) const {
+  if (counts.empty()) {
+    counts.assign(static_cast<size_t>(_x_dim)*_y_dim, 0);
+  }
+  if (counts.size() != static_cast<size_t>(_x_dim)*_y_dim) {
+    throw std::runtime_error("Visit counts do not match the grid");
+  }
+  for (unsigned int y = 0; y < _y_dim; y++) {
+    for (unsigned int x = 0; x < _x_dim; x++) {
+      counts[static_cast<size_t>(y)*_x_dim+x] += _nodes[y][x]._num_visits;
+    }
+  }
+}
+
+// Sum the average number of visits over blocks of nodes
+void Grid::get_visit_map(
+    std::vector<float> & map, double num_walks,
+    unsigned int downsample) const {
+  if (downsample == 0) {
+    throw std::runtime_error("Downsample factor must be positive");
+  }
+  unsigned int map_x_dim = (_x_dim + downsample - 1) / downsample;
+  unsigned int map_y_dim = (_y_dim + downsample - 1) / downsample;
+  map.assign(static_cast<size_t>(map_x_dim)*map_y_dim, 0.0f);
+  for (unsigned int y = 0; y < _y_dim; y++) {
+    float * map_row = map.data() + static_cast<size_t>(y/downsample)*map_x_dim;
+    for (unsigned int x = 0; x < _x_dim; x++) {
+      map_row[x/downsample] += _nodes[y][x]._num_visits / num_walks;
+    }
+  }
+}
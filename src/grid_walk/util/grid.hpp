@@ -5,10 +5,22 @@
 #include "dist.hpp"
 
 #include <cmath>
-#include <fstream>
+#include <cstdint>
+#include <istream>
+#include <ostream>
 #include <utility>
 #include <vector>
 
+// Utility namespace
+namespace util {
+
+// Enumerated list of grid file formats
+// text_grid: dimensions, start, goal, and a matrix of 0/1 reachability
+// binary_grid: bit packed reachability, see Grid::read_binary
+enum grid_format {text_grid, binary_grid};
+
+} // end namespace util
+
 // Class governing the grid of the random walk
 // x dimension runs from 0 to _x_dim-1
 // y dimension runs from 0 to _y_dim-1
@@ -38,18 +50,64 @@ private:
   util::Coord _start, _goal;
   // Nodes of the grid
   std::vector<std::vector<Node>> _nodes;
+  // Number of contiguous reachable nodes from each node in each direction,
+  // 8 per node in the order of the direction enum, saturating at
+  // max_run_length so a node costs 16 bytes. Kept up to date by
+  // set_reachable, which recomputes only the lines through the changed
+  // nodes.
+  std::vector<uint16_t> _run_lengths;
+  // Whether the goal can be reached from the start, -1 until computed after
+  // the last change of reachability
+  mutable signed char _goal_connected = -1;
+  // Nodes of the path from start to goal found by the last search, row by
+  // row, empty unless the goal is known to be reachable
+  mutable std::vector<bool> _goal_path;
+  // Hash of the grid, valid until the next change of reachability
+  mutable uint64_t _hash = 0;
+  mutable bool _hash_valid = false;
+  // Difference arrays of the path tally, one per orientation of travel
+  // (east-west, north-south, north_west-south_east, north_east-south_west),
+  // each padded by one node on every side. Empty until a path is tallied.
+  std::vector<long long> _path_diffs;
+
+  // Index of a node in a padded difference array
+  size_t path_index(long long x, long long y) const {
+    return static_cast<size_t>(y+1)*(_x_dim+2) + (x+1);
+  }
+
+  // Index of the run lengths of the node at x, y in _run_lengths
+  size_t run_index(unsigned int x, unsigned int y) const {
+    return (static_cast<size_t>(y)*_x_dim + x)*util::all_directions.size();
+  }
 
   // Returns true if node at coordinate is reachable
   bool reachableNode(const util::Coord & coord) const;
 
+  // Computes the run lengths of every node in every direction
+  void build_run_lengths();
+
+  // Recomputes the run lengths in dir of every node of the grid line in dir
+  // through x, y, from the far end of the line back
+  void update_run_lengths(long long x, long long y, util::direction dir);
+
+  // Reads the binary grid format following the magic string
+  void read_binary(std::istream & input_file);
+
 public:
-  // Ctor from input file
-  Grid(std::ifstream & input_file);
+  // Ctor from input file in either the text or binary format
+  Grid(std::istream & input_file);
+  // Ctor from dimensions, start, goal, and the reachability of each node
+  // stored row by row
+  Grid(unsigned int x_dim, unsigned int y_dim, util::Coord start,
+       util::Coord goal, const std::vector<bool> & reachable);
   // Deep copy ctor
   Grid(const Grid * other_grid)
     : _x_dim(other_grid->_x_dim), _y_dim(other_grid->_y_dim),
       _start(other_grid->_start), _goal(other_grid->_goal),
-      _nodes(other_grid->_nodes) {};
+      _nodes(other_grid->_nodes), _run_lengths(other_grid->_run_lengths),
+      _goal_connected(other_grid->_goal_connected),
+      _goal_path(other_grid->_goal_path), _hash(other_grid->_hash),
+      _hash_valid(other_grid->_hash_valid) {};
   Grid() {};
   ~Grid() {};
 
@@ -60,18 +118,67 @@ public:
     _start = other_grid->_start;
     _goal = other_grid->_goal;
     _nodes = other_grid->_nodes;
+    _run_lengths = other_grid->_run_lengths;
+    _goal_connected = other_grid->_goal_connected;
+    _goal_path = other_grid->_goal_path;
+    _hash = other_grid->_hash;
+    _hash_valid = other_grid->_hash_valid;
   }
 
+  // Longest run length stored per node, longer runs are counted node by
+  // node past it
+  static const uint16_t max_run_length = 0xffff;
+
   // Returns the starting coordinate of the walk
   util::Coord get_start() const { return _start; }
 
   // Returns the goal coordinate of the walk
   util::Coord get_goal() const { return _goal; }
 
+  // Returns true if the node at coord is in the grid and reachable
+  bool is_reachable(const util::Coord & coord) const {
+    return reachableNode(coord);
+  }
+
+  // Set the reachability of the node at coord, see set_reachable below
+  void set_reachable(const util::Coord & coord, bool reachable) {
+    set_reachable(coord, coord, reachable);
+  }
+
+  // Set the reachability of every node of the rectangle with corners first
+  // and last, inclusive. Only the run lengths of the rows, columns, and
+  // diagonals through the rectangle are recomputed. Whether the goal can be
+  // reached is kept if opening nodes or blocking nodes off the last path
+  // found from start to goal, and is otherwise searched again on its next
+  // query. Returns the number of nodes whose reachability changed. Not safe
+  // while walks run on the grid.
+  size_t set_reachable(
+    const util::Coord & first, const util::Coord & last, bool reachable);
+
+  // Returns the number of nodes in the x dimension
+  unsigned int get_x_dim() const { return _x_dim; }
+
+  // Returns the number of nodes in the y dimension
+  unsigned int get_y_dim() const { return _y_dim; }
+
+  // Returns a hash of the dimensions, start, goal, and reachability of every
+  // node, identifying the grid independently of its file format. The hash
+  // is computed on the first call after each change of reachability.
+  uint64_t hash() const;
+
+  // Returns true if the goal can be reached from the start through
+  // reachable nodes, searched on the first query after each change of
+  // reachability
+  bool goal_reachable() const;
+
   // Returns a vector of directions that have valid neighboring nodes
   std::vector<util::direction> get_directions(
     const util::Coord & curr_coord) const;
 
+  // Returns the directions of get_directions as a bit mask, bit dir set if
+  // dir has a valid neighbouring node
+  uint8_t get_direction_mask(const util::Coord & curr_coord) const;
+
   // Return the number of contiguous valid nodes from coord in dir
   unsigned int get_distance(
     const util::Coord & coord, util::direction dir) const;
@@ -79,11 +186,37 @@ public:
   // Tally the number of visits at the current node
   void visit(const util::Coord & coord);
 
+  // Tally a visit to every node traversed by a move of dist nodes in dir
+  // ending at coord, excluding the node the move started from. Each move
+  // costs two difference array updates, resolved by resolve_paths.
+  void visit_path(
+    const util::Coord & coord, util::direction dir, unsigned int dist);
+
+  // Add the tallied paths to the visits of each node with one prefix sum
+  // pass per orientation and clear the path tally
+  void resolve_paths();
+
   // Set the number of visits count to zero for all nodes
   void clear_visits();
 
+  // Write the grid, start, and goal in the passed format
+  void write(
+    std::ostream & output_file,
+    util::grid_format format = util::grid_format::text_grid) const;
+
   // Print the average number of visits to each node per walk
   void print(std::ostream & output_file, double num_walks) const;
+
+  // Add the raw number of visits of every node row by row to counts, which
+  // is sized to x_dim*y_dim if empty
+  void add_visits(std::vector<uint64_t> & counts) const;
+
+  // Fill map with the average number of visits per walk row by row,
+  // summing over downsample x downsample blocks of nodes. The map has
+  // ceil(x_dim/downsample) columns and ceil(y_dim/downsample) rows.
+  void get_visit_map(
+    std::vector<float> & map, double num_walks,
+    unsigned int downsample = 1) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "grid_generator.hpp"
+
+#include "rand.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Width in nodes of the passages of corridor grids
+static const unsigned int corridor_width = 3;
+
+// Reachability, start, and goal of a generated grid before obstacles
+struct Layout {
+  unsigned int _x_dim, _y_dim;
+  std::vector<bool> _reachable;
+  Coord _start, _goal;
+
+  Layout(unsigned int x_dim, unsigned int y_dim, bool reachable)
+    : _x_dim(x_dim), _y_dim(y_dim),
+      _reachable(static_cast<size_t>(x_dim)*y_dim, reachable) {};
+
+  size_t index(unsigned int x, unsigned int y) const {
+    return static_cast<size_t>(y)*_x_dim + x;
+  }
+};
+
+// Returns a random integer in [0, n)
+static unsigned int sample_index(RNG & rng, unsigned int n) {
+  return std::min<unsigned int>(rng.sample()*n, n-1);
+}
+
+// Every node is reachable, start and goal are on the horizontal center line
+// a quarter of the way in from each side
+static Layout generate_open(unsigned int x_dim, unsigned int y_dim) {
+  Layout layout(x_dim, y_dim, true);
+  layout._start = Coord(x_dim/4, y_dim/2);
+  layout._goal = Coord(x_dim-1-x_dim/4, y_dim/2);
+  return layout;
+}
+
+// Randomized depth first search over the nodes with odd coordinates,
+// removing the wall node between each cell and the next cell visited.
+// Start is the top left cell and goal the bottom right cell.
+static Layout generate_maze(
+    unsigned int x_dim, unsigned int y_dim, RNG & rng) {
+  if (x_dim < 3 || y_dim < 3) {
+    throw std::runtime_error("Maze grids must be at least 3x3");
+  }
+  Layout layout(x_dim, y_dim, false);
+  // Cells are the nodes at odd coordinates inside the border
+  unsigned int x_cells = (x_dim-1)/2;
+  unsigned int y_cells = (y_dim-1)/2;
+  std::vector<bool> visited(static_cast<size_t>(x_cells)*y_cells, false);
+  std::vector<std::pair<unsigned int, unsigned int>> stack = {{0, 0}};
+  visited[0] = true;
+  layout._reachable[layout.index(1, 1)] = true;
+  const int offsets[4][2] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+  while (!stack.empty()) {
+    auto cell = stack.back();
+    // Collect unvisited neighbouring cells
+    int options[4];
+    int num_options = 0;
+    for (int k = 0; k < 4; k++) {
+      long nx = static_cast<long>(cell.first) + offsets[k][0];
+      long ny = static_cast<long>(cell.second) + offsets[k][1];
+      if (nx >= 0 && ny >= 0 && nx < x_cells && ny < y_cells &&
+          !visited[static_cast<size_t>(ny)*x_cells+nx]) {
+        options[num_options++] = k;
+      }
+    }
+    if (num_options == 0) {
+      stack.pop_back();
+      continue;
+    }
+    int k = options[sample_index(rng, num_options)];
+    unsigned int nx = cell.first + offsets[k][0];
+    unsigned int ny = cell.second + offsets[k][1];
+    visited[static_cast<size_t>(ny)*x_cells+nx] = true;
+    // Open the wall between the cells and the new cell
+    layout._reachable[layout.index(1+cell.first+nx, 1+cell.second+ny)] = true;
+    layout._reachable[layout.index(1+2*nx, 1+2*ny)] = true;
+    stack.push_back({nx, ny});
+  }
+  layout._start = Coord(1, 1);
+  layout._goal = Coord(2*x_cells-1, 2*y_cells-1);
+  return layout;
+}
+
+// Horizontal passages separated by single node walls with an opening at
+// alternating ends, the bottom row is always a passage. Start is the top left
+// node and goal the far end of the last passage.
+static Layout generate_corridor(unsigned int x_dim, unsigned int y_dim) {
+  Layout layout(x_dim, y_dim, true);
+  unsigned int num_walls = 0;
+  for (unsigned int y = corridor_width; y+1 < y_dim; y += corridor_width+1) {
+    unsigned int opening = (num_walls % 2 == 0) ? x_dim-1 : 0;
+    for (unsigned int x = 0; x < x_dim; x++) {
+      if (x != opening) { layout._reachable[layout.index(x, y)] = false; }
+    }
+    ++num_walls;
+  }
+  // The last passage is walked in the direction of the last opening
+  layout._start = Coord(0, 0);
+  layout._goal = Coord((num_walls % 2 == 0) ? x_dim-1 : 0, y_dim-1);
+  return layout;
+}
+
+// Square rooms separated by single node walls with a door at a random
+// position in every wall between neighbouring rooms. Start is the center of
+// the top left room and goal the center of the bottom right room.
+static Layout generate_rooms(
+    unsigned int x_dim, unsigned int y_dim, unsigned int room_size,
+    RNG & rng) {
+  if (room_size == 0) {
+    throw std::runtime_error("Room size must be positive");
+  }
+  Layout layout(x_dim, y_dim, true);
+  const unsigned int pitch = room_size+1;
+  // Walls
+  for (unsigned int y = 0; y < y_dim; y++) {
+    for (unsigned int x = 0; x < x_dim; x++) {
+      if (x % pitch == room_size || y % pitch == room_size) {
+        layout._reachable[layout.index(x, y)] = false;
+      }
+    }
+  }
+  // Doors in the vertical walls then the horizontal walls
+  for (unsigned int wx = room_size; wx+1 < x_dim; wx += pitch) {
+    for (unsigned int ry = 0; ry < y_dim; ry += pitch) {
+      unsigned int span = std::min(room_size, y_dim-ry);
+      layout._reachable[layout.index(wx, ry+sample_index(rng, span))] = true;
+    }
+  }
+  for (unsigned int wy = room_size; wy+1 < y_dim; wy += pitch) {
+    for (unsigned int rx = 0; rx < x_dim; rx += pitch) {
+      unsigned int span = std::min(room_size, x_dim-rx);
+      layout._reachable[layout.index(rx+sample_index(rng, span), wy)] = true;
+    }
+  }
+  // Centers of the first and last rooms, rooms cut off by the edge of the
+  // grid are centered on their reachable span
+  unsigned int last_x = ((x_dim-1)/pitch)*pitch;
+  unsigned int last_y = ((y_dim-1)/pitch)*pitch;
+  layout._start = Coord((std::min(room_size, x_dim)-1)/2,
+                        (std::min(room_size, y_dim)-1)/2);
+  layout._goal = Coord(last_x + (std::min(room_size, x_dim-last_x)-1)/2,
+                       last_y + (std::min(room_size, y_dim-last_y)-1)/2);
+  return layout;
+}
+
+// Randomly block the passed fraction of reachable nodes other than the start
+// and goal
+static void add_obstacles(Layout & layout, double density, RNG & rng) {
+  if (density <= 0) { return; }
+  if (density >= 1) {
+    throw std::runtime_error("Obstacle density must be less than one");
+  }
+  size_t start = layout.index(layout._start._x_coord, layout._start._y_coord);
+  size_t goal = layout.index(layout._goal._x_coord, layout._goal._y_coord);
+  for (size_t i = 0; i < layout._reachable.size(); i++) {
+    if (layout._reachable[i] && i != start && i != goal &&
+        rng.sample() < density) {
+      layout._reachable[i] = false;
+    }
+  }
+}
+
+// Guarantee the goal is reachable from the start. Walkers move between
+// neighbouring nodes in all 8 directions, so a 0-1 breadth first search
+// where blocked nodes cost one finds the path from the start to the goal
+// opening the fewest blocked nodes, which are then opened.
+static void connect_start_to_goal(Layout & layout) {
+  const size_t num_nodes = layout._reachable.size();
+  const size_t unvisited = num_nodes;
+  size_t start = layout.index(layout._start._x_coord, layout._start._y_coord);
+  size_t goal = layout.index(layout._goal._x_coord, layout._goal._y_coord);
+  layout._reachable[start] = true;
+  layout._reachable[goal] = true;
+
+  std::vector<unsigned int> cost(num_nodes, UINT_MAX);
+  std::vector<size_t> parent(num_nodes, unvisited);
+  std::deque<size_t> queue = {start};
+  cost[start] = 0;
+  while (!queue.empty()) {
+    size_t node = queue.front();
+    queue.pop_front();
+    if (node == goal) { break; }
+    long x = node % layout._x_dim;
+    long y = node / layout._x_dim;
+    for (long dy = -1; dy <= 1; dy++) {
+      for (long dx = -1; dx <= 1; dx++) {
+        long nx = x+dx;
+        long ny = y+dy;
+        if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 ||
+            nx >= layout._x_dim || ny >= layout._y_dim) {
+          continue;
+        }
+        size_t next = layout.index(nx, ny);
+        unsigned int step_cost = layout._reachable[next] ? 0 : 1;
+        if (cost[node]+step_cost < cost[next]) {
+          cost[next] = cost[node]+step_cost;
+          parent[next] = node;
+          if (step_cost == 0) { queue.push_front(next); }
+          else { queue.push_back(next); }
+        }
+      }
+    }
+  }
+  for (size_t node = goal; node != start; node = parent[node]) {
+    layout._reachable[node] = true;
+  }
+}
+
+Grid generate_grid(const GridSpec & spec) {
+  if (spec._x_dim == 0 || spec._y_dim == 0) {
+    throw std::runtime_error("Grid dimensions must be positive");
+  }
+  RNG rng(spec._seed);
+  Layout layout = [&]() {
+    switch (spec._type) {
+      case open_field:
+        return generate_open(spec._x_dim, spec._y_dim);
+      case maze:
+        return generate_maze(spec._x_dim, spec._y_dim, rng);
+      case corridor:
+        return generate_corridor(spec._x_dim, spec._y_dim);
+      case rooms:
+        return generate_rooms(spec._x_dim, spec._y_dim, spec._room_size, rng);
+      default:
+        throw std::runtime_error("Unknown grid type to generate");
+    }
+  }();
+  add_obstacles(layout, spec._obstacle_density, rng);
+  connect_start_to_goal(layout);
+  return Grid(layout._x_dim, layout._y_dim, layout._start, layout._goal,
+              layout._reachable);
+}
+
+Grid generate_grid(
+    grid_type type, unsigned int x_dim, unsigned int y_dim, double seed) {
+  GridSpec spec;
+  spec._type = type;
+  spec._x_dim = x_dim;
+  spec._y_dim = y_dim;
+  spec._seed = seed;
+  return generate_grid(spec);
+}
+
+grid_type to_grid_type(const std::string & name) {
+  if (name == "open") { return grid_type::open_field; }
+  if (name == "maze") { return grid_type::maze; }
+  if (name == "corridor") { return grid_type::corridor; }
+  if (name == "rooms") { return grid_type::rooms; }
+  throw std::runtime_error("Grid type "+name+" not recognized");
+}
+
+} // end namespace util
@@ -0,0 +1,50 @@
+#ifndef __GRID_GENERATOR_HEADER__
+#define __GRID_GENERATOR_HEADER__
+
+#include "grid.hpp"
+
+#include <string>
+
+// Utility namespace
+namespace util {
+
+// Enumerated list of synthetic grid layouts
+// open_field: every node reachable
+// maze: perfect maze of one node wide passages and walls
+// corridor: serpentine corridor sweeping back and forth down the grid
+// rooms: square rooms separated by walls with a door in every wall
+enum grid_type {open_field, maze, corridor, rooms};
+
+// Parameters of a synthetic grid
+struct GridSpec {
+  // Layout of the grid
+  grid_type _type = grid_type::open_field;
+  // Dimensions of the grid
+  unsigned int _x_dim = 10;
+  unsigned int _y_dim = 10;
+  // Fraction of the reachable nodes of the layout randomly blocked
+  double _obstacle_density = 0.0;
+  // Number of nodes per side of the rooms of rooms grids
+  unsigned int _room_size = 8;
+  // Seed of the random number generator
+  double _seed = 16180339;
+};
+
+// Returns a synthetic grid following the passed specification. Generation is
+// reproducible for a given seed. Start and goal are always reachable and the
+// goal is always reachable from the start, blocked nodes are opened along a
+// path between them if obstacles would otherwise disconnect them.
+Grid generate_grid(const GridSpec & spec);
+
+// Returns a synthetic grid of the passed layout and dimensions
+Grid generate_grid(
+  grid_type type, unsigned int x_dim, unsigned int y_dim,
+  double seed = 16180339);
+
+// Returns the layout matching a layout name,
+// "open", "maze", "corridor", or "rooms"
+grid_type to_grid_type(const std::string & name);
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __HASH_HEADER__
+#define __HASH_HEADER__
+
+#include <cstddef>
+#include <cstdint>
+
+// Utility namespace
+namespace util {
+
+// Initial value of the 64 bit FNV-1a hash
+static const uint64_t fnv_offset = 14695981039346656037ull;
+
+// 64 bit FNV-1a hash of size bytes, continuing from a previous hash so
+// several values can be hashed in turn
+inline uint64_t fnv1a(
+    const void * data, size_t size, uint64_t hash = fnv_offset) {
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+} // end namespace util
+
+#endif
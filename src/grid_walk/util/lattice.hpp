@@ -0,0 +1,26 @@
+#ifndef __LATTICE_HEADER__
+#define __LATTICE_HEADER__
+
+#include <array>
+
+// Utility namespace
+namespace util {
+
+// Directions to the neighbours of a node of a D dimensional lattice and the
+// coordinate increment of each, fixed at compile time so loops over the
+// directions unroll. Only the 2-D lattice of Grid is defined.
+template <unsigned int D>
+struct Lattice;
+
+// The 8 neighbours of a 2-D node clockwise from north, the order of the
+// direction enum, with y increasing downward
+template <>
+struct Lattice<2> {
+  static constexpr unsigned int num_directions = 8;
+  static constexpr std::array<std::array<int, 2>, num_directions> increments =
+    {{{0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}}};
+};
+
+} // end namespace util
+
+#endif
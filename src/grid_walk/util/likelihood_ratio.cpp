@@ -0,0 +1,127 @@
+#include "likelihood_ratio.hpp"
+
+#include "results_writer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Number of direction weights of each PMF
+static const unsigned int num_directions = 8;
+
+LikelihoodRatios::LikelihoodRatios(
+    const std::vector<double> & reference, unsigned int max_dist)
+    : _max_dist(max_dist) {
+  if (reference.size() != num_PMF_params) {
+    throw std::runtime_error(
+      "Reference PMFs need "+std::to_string(num_PMF_params)+" parameters");
+  }
+  _reference.assign(reference.begin(), reference.begin()+num_directions);
+  _reference_lambda = reference[num_directions];
+}
+
+// The distance PMF truncated at b is
+// exp(-lambda*(k-1))*(1-exp(-lambda))/(1-exp(-lambda*b)) for k = 1..b
+double LikelihoodRatios::log_truncation(
+    const Target & target, unsigned int b) const {
+  auto log_mass = [](double lambda, double n) {
+    return std::log(-std::expm1(-lambda*n));
+  };
+  return log_mass(target._lambda, 1) - log_mass(_reference_lambda, 1) -
+    log_mass(target._lambda, b) + log_mass(_reference_lambda, b);
+}
+
+size_t LikelihoodRatios::add_target(const std::vector<double> & params) {
+  if (params.size() != num_PMF_params) {
+    throw std::runtime_error(
+      "Target PMFs need "+std::to_string(num_PMF_params)+" parameters");
+  }
+  Target target;
+  target._lambda = params[num_directions];
+  target._delta_lambda = target._lambda - _reference_lambda;
+  for (unsigned int d = 0; d < num_directions; d++) {
+    if (params[d] > 0 && !(_reference[d] > 0)) { target._supported = false; }
+    // Directions the reference never takes are never weighted, those only
+    // the target never takes zero the weight
+    if (!(_reference[d] > 0)) { target._log_dir[d] = 0; }
+    else if (!(params[d] > 0)) {
+      target._log_dir[d] = -std::numeric_limits<double>::infinity();
+    }
+    else {
+      target._log_dir[d] = std::log(params[d]) - std::log(_reference[d]);
+    }
+  }
+  for (unsigned int mask = 1; mask < 256; mask++) {
+    double target_total = 0, reference_total = 0;
+    for (unsigned int d = 0; d < num_directions; d++) {
+      if (mask & (1u << d)) {
+        target_total += params[d];
+        reference_total += _reference[d];
+      }
+    }
+    target._log_norm[mask] = target_total > 0 && reference_total > 0 ?
+      std::log(target_total) - std::log(reference_total) : 0;
+  }
+  target._log_dist.resize(_max_dist+1, 0.0);
+  for (unsigned int b = 1; b <= _max_dist; b++) {
+    target._log_dist[b] = log_truncation(target, b);
+  }
+  _targets.push_back(std::move(target));
+  return _targets.size()-1;
+}
+
+void LikelihoodRatios::end_history(unsigned long long steps) {
+  ++_num_histories;
+  const double t = steps;
+  for (auto & target : _targets) {
+    if (!target._supported ||
+        target._log_weight == -std::numeric_limits<double>::infinity()) {
+      continue;
+    }
+    // Rescale the sums to the largest weight so far
+    if (target._sum_w == 0 || target._log_weight > target._max_log_weight) {
+      double scale = target._sum_w == 0 ? 0 :
+        std::exp(target._max_log_weight - target._log_weight);
+      target._sum_w *= scale;
+      target._sum_wt *= scale;
+      target._sum_w2 *= scale*scale;
+      target._sum_w2t *= scale*scale;
+      target._sum_w2t2 *= scale*scale;
+      target._max_log_weight = target._log_weight;
+    }
+    double w = std::exp(target._log_weight - target._max_log_weight);
+    target._sum_w += w;
+    target._sum_wt += w*t;
+    target._sum_w2 += w*w;
+    target._sum_w2t += w*w*t;
+    target._sum_w2t2 += w*w*t*t;
+  }
+}
+
+double LikelihoodRatios::mean(size_t i) const {
+  const Target & target = _targets[i];
+  return target._sum_w > 0 ? target._sum_wt / target._sum_w : 0;
+}
+
+// Var(sum w*t / sum w) ~ sum w^2*(t-mean)^2 / (sum w)^2
+double LikelihoodRatios::error(size_t i) const {
+  const Target & target = _targets[i];
+  if (!(target._sum_w > 0)) { return 0; }
+  double m = mean(i);
+  double sum_sq = target._sum_w2t2 - 2*m*target._sum_w2t +
+    m*m*target._sum_w2;
+  return std::sqrt(std::max(0.0, sum_sq)) / target._sum_w;
+}
+
+double LikelihoodRatios::effective_samples(size_t i) const {
+  const Target & target = _targets[i];
+  if (!target._supported || !(target._sum_w2 > 0)) { return 0; }
+  return target._sum_w*target._sum_w / target._sum_w2;
+}
+
+} // end namespace util
@@ -0,0 +1,116 @@
+#ifndef __LIKELIHOOD_RATIO_HEADER__
+#define __LIKELIHOOD_RATIO_HEADER__
+
+#include "dist.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Estimates the mean number of steps of many target PMFs from histories
+// walked with one reference PMF. Each history is weighted for each target by
+// the product over its steps of the target over the reference probability
+// of the direction, among the directions open at the node, and of the
+// distance, among the distances open in that direction. Weights are kept as
+// logarithms and the sums of each target rescaled to its largest weight so
+// long histories neither overflow nor underflow. Means are self normalized,
+// sum w*t / sum w, with the delta method variance, and the effective sample
+// size (sum w)^2 / sum w^2 measures how far the weights have degenerated.
+class LikelihoodRatios {
+private:
+  // Log ratios and weight sums of a single target PMF
+  struct Target {
+    // Log of the target over the reference weight of each direction
+    double _log_dir[8] = {};
+    // Log of the target over the reference total weight of the directions
+    // open at a node, indexed by the bit mask of open directions
+    double _log_norm[256] = {};
+    // Target minus reference lambda
+    double _delta_lambda = 0;
+    // Log ratio of the distance PMFs truncated at b, less the term of the
+    // distance travelled, indexed by b up to the max distance
+    std::vector<double> _log_dist;
+    double _lambda = 1;
+    // False if the target can take a decision the reference never takes
+    bool _supported = true;
+    // Log weight of the current history
+    double _log_weight = 0;
+    // Largest log weight of any history, the scale of the sums
+    double _max_log_weight = 0;
+    // Sums of w, w*t, w^2, w^2*t, and w^2*t^2 over every history
+    double _sum_w = 0;
+    double _sum_wt = 0;
+    double _sum_w2 = 0;
+    double _sum_w2t = 0;
+    double _sum_w2t2 = 0;
+  };
+  // Reference direction weights and lambda
+  std::vector<double> _reference;
+  double _reference_lambda = 1;
+  // Longest distance tabulated for every target
+  unsigned int _max_dist = 0;
+  std::vector<Target> _targets;
+  uint64_t _num_histories = 0;
+
+  // Log ratio of the distance PMFs of a target truncated at b, less the term
+  // of the distance travelled
+  double log_truncation(const Target & target, unsigned int b) const;
+
+public:
+  // reference holds the 9 PMF parameters histories are walked with, and
+  // max_dist the longest distance open from any node, longer distances are
+  // supported but computed at every step
+  LikelihoodRatios(
+    const std::vector<double> & reference, unsigned int max_dist);
+  ~LikelihoodRatios() {};
+
+  // Add a target PMF of 9 parameters, returns its index
+  size_t add_target(const std::vector<double> & params);
+
+  // Number of target PMFs
+  size_t size() const { return _targets.size(); }
+
+  // Return false if target i takes decisions the reference never takes, its
+  // histories cannot be reweighted
+  bool supported(size_t i) const { return _targets[i]._supported; }
+
+  // Start a new history with weight 1 for every target
+  void begin_history() {
+    for (auto & target : _targets) { target._log_weight = 0; }
+  }
+
+  // Weight a step of dist nodes in dir from a node with the open directions
+  // of mask and total nodes open in dir
+  void add_step(
+      uint8_t mask, direction dir, unsigned int total, unsigned int dist) {
+    // A distance of 0 has no probability under any lambda
+    if (dist == 0) { return; }
+    for (auto & target : _targets) {
+      target._log_weight += target._log_dir[dir] - target._log_norm[mask] -
+        target._delta_lambda*(dist-1.0) +
+        (total < target._log_dist.size() ?
+          target._log_dist[total] : log_truncation(target, total));
+    }
+  }
+
+  // End the history after steps steps and add it to the sums of every target
+  void end_history(unsigned long long steps);
+
+  // Number of histories added
+  uint64_t num_histories() const { return _num_histories; }
+
+  // Estimate of the mean number of steps of target i
+  double mean(size_t i) const;
+
+  // Standard deviation of the estimate of the mean of target i
+  double error(size_t i) const;
+
+  // Effective sample size of the weights of target i
+  double effective_samples(size_t i) const;
+};
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,203 @@
+#include "mlp.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+// Utility namespace
+namespace util {
+
+// Magic string starting model files
+static const char model_magic[8] = {'G','W','M','L','P','0','0','1'};
+
+MLP::MLP(const std::string & filename) {
+  std::ifstream input_file(filename, std::ios::in | std::ios::binary);
+  if (!input_file.is_open()) {
+    throw std::runtime_error("Failed to open model file "+filename);
+  }
+  read(input_file);
+}
+
+void MLP::add_layer(
+    unsigned int num_inputs, unsigned int num_outputs,
+    const std::vector<float> & weights, const std::vector<float> & biases) {
+  if (!_layers.empty() && _layers.back()._num_outputs != num_inputs) {
+    throw std::runtime_error("Layer inputs do not match previous outputs");
+  }
+  if (weights.size() != static_cast<size_t>(num_inputs)*num_outputs ||
+      biases.size() != num_outputs) {
+    throw std::runtime_error("Layer parameters have the wrong size");
+  }
+  _layers.push_back({num_inputs, num_outputs, weights, biases});
+  _max_width = std::max(_max_width, std::max(num_inputs, num_outputs));
+}
+
+void MLP::fold_input_scaling(
+    const std::vector<double> & scale, const std::vector<double> & offset) {
+  if (_layers.empty() || scale.size() != num_inputs() ||
+      offset.size() != num_inputs()) {
+    throw std::runtime_error("Input scaling does not match the model");
+  }
+  Layer & layer = _layers.front();
+  for (unsigned int j = 0; j < layer._num_outputs; j++) {
+    float * row = layer._weights.data() +
+      static_cast<size_t>(j)*layer._num_inputs;
+    double bias = layer._biases[j];
+    for (unsigned int k = 0; k < layer._num_inputs; k++) {
+      bias += row[k]*offset[k];
+      row[k] *= scale[k];
+    }
+    layer._biases[j] = bias;
+  }
+}
+
+void MLP::fold_output_scaling(
+    const std::vector<double> & scale, const std::vector<double> & offset) {
+  if (_layers.empty() || scale.size() != _layers.back()._num_outputs ||
+      offset.size() != scale.size()) {
+    throw std::runtime_error("Output scaling does not match the model");
+  }
+  Layer & layer = _layers.back();
+  for (unsigned int j = 0; j < layer._num_outputs; j++) {
+    float * row = layer._weights.data() +
+      static_cast<size_t>(j)*layer._num_inputs;
+    for (unsigned int k = 0; k < layer._num_inputs; k++) {
+      row[k] /= scale[j];
+    }
+    layer._biases[j] = (layer._biases[j] - offset[j])/scale[j];
+  }
+}
+
+// Model File Format:
+// [magic] [uint32 num_layers] [float32 alpha]
+// then for each layer
+// [uint32 num_inputs] [uint32 num_outputs]
+// [float32 weights, row major num_outputs x num_inputs] [float32 biases]
+void MLP::read(std::istream & input_file) {
+  char magic[sizeof(model_magic)];
+  input_file.read(magic, sizeof(magic));
+  if (!input_file || !std::equal(magic, magic+sizeof(magic), model_magic)) {
+    throw std::runtime_error("Not a surrogate model file");
+  }
+  unsigned int num_layers;
+  input_file.read(reinterpret_cast<char *>(&num_layers), sizeof(num_layers));
+  input_file.read(reinterpret_cast<char *>(&_alpha), sizeof(_alpha));
+  _layers.clear();
+  _max_width = 0;
+  for (unsigned int l = 0; l < num_layers && input_file; l++) {
+    unsigned int dims[2];
+    input_file.read(reinterpret_cast<char *>(dims), sizeof(dims));
+    std::vector<float> weights(static_cast<size_t>(dims[0])*dims[1]);
+    std::vector<float> biases(dims[1]);
+    input_file.read(reinterpret_cast<char *>(weights.data()),
+                    weights.size()*sizeof(float));
+    input_file.read(reinterpret_cast<char *>(biases.data()),
+                    biases.size()*sizeof(float));
+    add_layer(dims[0], dims[1], weights, biases);
+  }
+  if (!input_file) {
+    throw std::runtime_error("Surrogate model file is truncated");
+  }
+}
+
+void MLP::write(std::ostream & output_file) const {
+  output_file.write(model_magic, sizeof(model_magic));
+  unsigned int num_layers = _layers.size();
+  output_file.write(
+    reinterpret_cast<const char *>(&num_layers), sizeof(num_layers));
+  output_file.write(reinterpret_cast<const char *>(&_alpha), sizeof(_alpha));
+  for (const auto & layer : _layers) {
+    unsigned int dims[2] = {layer._num_inputs, layer._num_outputs};
+    output_file.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+    output_file.write(reinterpret_cast<const char *>(layer._weights.data()),
+                      layer._weights.size()*sizeof(float));
+    output_file.write(reinterpret_cast<const char *>(layer._biases.data()),
+                      layer._biases.size()*sizeof(float));
+  }
+}
+
+// Activations are stored feature by feature with tile_size samples each so
+// the loops over samples have a fixed trip count and vectorize
+void MLP::predict_range(
+    const float * inputs, size_t begin, size_t end, float * outputs) const {
+  const unsigned int T = tile_size;
+  std::vector<float> current(static_cast<size_t>(_max_width)*T);
+  std::vector<float> next(static_cast<size_t>(_max_width)*T);
+  const unsigned int num_in = num_inputs();
+  const unsigned int num_out = _layers.back()._num_outputs;
+
+  for (size_t tile = begin; tile < end; tile += T) {
+    const unsigned int count = std::min<size_t>(T, end-tile);
+    // Transpose the tile of inputs, padding a partial tile with zeros
+    std::fill(current.begin(), current.begin()+num_in*T, 0.0f);
+    for (unsigned int b = 0; b < count; b++) {
+      const float * sample = inputs + (tile+b)*num_in;
+      for (unsigned int k = 0; k < num_in; k++) {
+        current[k*T+b] = sample[k];
+      }
+    }
+
+    for (size_t l = 0; l < _layers.size(); l++) {
+      const Layer & layer = _layers[l];
+      const bool hidden = (l+1 < _layers.size());
+      for (unsigned int j = 0; j < layer._num_outputs; j++) {
+        float acc[T];
+        for (unsigned int b = 0; b < T; b++) { acc[b] = layer._biases[j]; }
+        const float * row = layer._weights.data() +
+          static_cast<size_t>(j)*layer._num_inputs;
+        for (unsigned int k = 0; k < layer._num_inputs; k++) {
+          const float w = row[k];
+          const float * a = current.data() + k*T;
+          for (unsigned int b = 0; b < T; b++) { acc[b] += w*a[b]; }
+        }
+        float * out = next.data() + j*T;
+        if (hidden) {
+          for (unsigned int b = 0; b < T; b++) {
+            out[b] = acc[b] > 0 ? acc[b] : _alpha*acc[b];
+          }
+        }
+        else {
+          for (unsigned int b = 0; b < T; b++) { out[b] = acc[b]; }
+        }
+      }
+      current.swap(next);
+    }
+
+    for (unsigned int b = 0; b < count; b++) {
+      for (unsigned int j = 0; j < num_out; j++) {
+        outputs[(tile+b)*num_out+j] = current[j*T+b];
+      }
+    }
+  }
+}
+
+void MLP::predict(
+    const float * inputs, size_t num_samples, float * outputs,
+    unsigned int num_threads) const {
+  if (_layers.empty()) {
+    throw std::runtime_error("Surrogate model has no layers");
+  }
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Split the batch into whole tiles per thread
+  size_t num_tiles = (num_samples + tile_size - 1) / tile_size;
+  num_threads = std::max<size_t>(1, std::min<size_t>(num_threads, num_tiles));
+  if (num_threads == 1) {
+    predict_range(inputs, 0, num_samples, outputs);
+    return;
+  }
+  size_t tiles_per_thread = (num_tiles + num_threads - 1) / num_threads;
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < num_threads; t++) {
+    size_t begin = std::min(num_samples, t*tiles_per_thread*tile_size);
+    size_t end = std::min(num_samples, (t+1)*tiles_per_thread*tile_size);
+    if (begin == end) { break; }
+    threads.emplace_back(
+      &MLP::predict_range, this, inputs, begin, end, outputs);
+  }
+  for (auto & thread : threads) { thread.join(); }
+}
+
+} // end namespace util
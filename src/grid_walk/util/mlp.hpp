@@ -0,0 +1,84 @@
+#ifndef __MLP_HEADER__
+#define __MLP_HEADER__
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Dependency free forward pass of the fully connected surrogate network
+// exported by gridwalkopt. Hidden layers use a LeakyReLU activation and the
+// output layer is linear. Inputs are scored in tiles of samples so the
+// inner loops vectorize, and batches are split across threads.
+class MLP {
+public:
+  // Number of samples evaluated together in the inner loops
+  static const unsigned int tile_size = 16;
+
+private:
+  // Single fully connected layer
+  struct Layer {
+    unsigned int _num_inputs;
+    unsigned int _num_outputs;
+    // Weights stored row by row, one row of num_inputs per output
+    std::vector<float> _weights;
+    std::vector<float> _biases;
+  };
+  // Layers from input to output
+  std::vector<Layer> _layers;
+  // Slope of the LeakyReLU activation for negative inputs
+  float _alpha = 0.03f;
+  // Largest layer width, sizes the scratch buffers
+  unsigned int _max_width = 0;
+
+  // Scores samples [begin, end) of a batch
+  void predict_range(
+    const float * inputs, size_t begin, size_t end, float * outputs) const;
+
+public:
+  MLP() {};
+  // Ctor from a model file written by write
+  MLP(const std::string & filename);
+  ~MLP() {};
+
+  // Add a layer following the current last layer, weights are row major
+  // with one row of num_inputs values per output
+  void add_layer(
+    unsigned int num_inputs, unsigned int num_outputs,
+    const std::vector<float> & weights, const std::vector<float> & biases);
+
+  // Fold a per input scaling x' = x*scale + offset applied before the first
+  // layer into its weights, so raw PMF parameters can be scored
+  void fold_input_scaling(
+    const std::vector<double> & scale, const std::vector<double> & offset);
+  // Fold the inverse of a per output scaling y' = y*scale + offset into the
+  // last layer, so predictions come out unscaled
+  void fold_output_scaling(
+    const std::vector<double> & scale, const std::vector<double> & offset);
+
+  // Set the slope of the LeakyReLU activation
+  void set_alpha(float alpha) { _alpha = alpha; }
+
+  // Number of input features
+  unsigned int num_inputs() const {
+    return _layers.empty() ? 0 : _layers.front()._num_inputs;
+  }
+
+  // Read or write the binary model format
+  void read(std::istream & input_file);
+  void write(std::ostream & output_file) const;
+
+  // Score num_samples samples stored one after another with num_inputs
+  // values each, writing one output per sample. The batch is split across
+  // num_threads threads, 0 uses all hardware threads.
+  void predict(
+    const float * inputs, size_t num_samples, float * outputs,
+    unsigned int num_threads = 1) const;
+};
+
+} // end namespace util
+
+#endif
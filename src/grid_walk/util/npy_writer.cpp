@@ -0,0 +1,67 @@
+#include "npy_writer.hpp"
+
+#include <stdexcept>
+#include <string>
+
+// Utility namespace
+namespace util {
+
+// Total size of the .npy preamble and header, multiple of 64 per the format
+static const size_t header_size = 128;
+
+// Size of the file stream buffer
+static const size_t buffer_size = 1 << 20;
+
+NpyWriter::NpyWriter(
+    const std::string & filename, unsigned int x_dim, unsigned int y_dim)
+    : _buffer(buffer_size), _x_dim(x_dim), _y_dim(y_dim) {
+  _output_file.rdbuf()->pubsetbuf(_buffer.data(), _buffer.size());
+  _output_file.open(filename, std::ios::out | std::ios::binary);
+  if (_output_file.is_open()) { write_header(); }
+}
+
+// Format version 1.0:
+// "\x93NUMPY" [major] [minor] [uint16 header length] [python dict literal]
+void NpyWriter::write_header() {
+  std::string dict = "{'descr': '<f4', 'fortran_order': False, 'shape': (" +
+    std::to_string(_num_maps) + ", " + std::to_string(_y_dim) + ", " +
+    std::to_string(_x_dim) + "), }";
+  const size_t preamble_size = 10;
+  if (dict.size()+1 > header_size-preamble_size) {
+    throw std::runtime_error("Map dimensions too large for .npy header");
+  }
+  dict.append(header_size-preamble_size-dict.size()-1, ' ');
+  dict.push_back('\n');
+
+  const unsigned short dict_size = dict.size();
+  const char preamble[preamble_size] = {
+    '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+    static_cast<char>(dict_size & 0xff), static_cast<char>(dict_size >> 8)};
+  _output_file.write(preamble, preamble_size);
+  _output_file.write(dict.data(), dict.size());
+}
+
+void NpyWriter::write(const std::vector<float> & map) {
+  if (!_output_file.is_open()) {
+    throw std::runtime_error("Spatial distribution file is not open");
+  }
+  if (map.size() != static_cast<size_t>(_x_dim)*_y_dim) {
+    throw std::runtime_error("Spatial distribution has the wrong size");
+  }
+  _output_file.write(
+    reinterpret_cast<const char *>(map.data()), map.size()*sizeof(float));
+  ++_num_maps;
+  // Update the number of maps in the header
+  auto end = _output_file.tellp();
+  _output_file.seekp(0);
+  write_header();
+  _output_file.seekp(end);
+}
+
+void NpyWriter::close() {
+  if (_output_file.is_open()) {
+    _output_file.close();
+  }
+}
+
+} // end namespace util
@@ -0,0 +1,49 @@
+#ifndef __NPY_WRITER_HEADER__
+#define __NPY_WRITER_HEADER__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Writes a stack of equally sized 2-D float32 maps to a single .npy file.
+// The array has shape (num_maps, y_dim, x_dim) in C order so map i of the
+// file is the dataset of case i. The shape in the header is rewritten as
+// maps are appended so the file is valid after every write.
+class NpyWriter {
+private:
+  // File being written to
+  std::ofstream _output_file;
+  // Buffer backing the file stream
+  std::vector<char> _buffer;
+  // Dimensions of each map
+  unsigned int _x_dim, _y_dim;
+  // Number of maps written so far
+  unsigned long long _num_maps = 0;
+
+  // Writes the magic string and array description padded to a fixed length
+  void write_header();
+
+public:
+  NpyWriter(
+    const std::string & filename, unsigned int x_dim, unsigned int y_dim);
+  ~NpyWriter() { close(); }
+
+  // True if the output file was opened successfully
+  bool is_open() const { return _output_file.is_open(); }
+
+  // Append a map of x_dim*y_dim values stored row by row
+  void write(const std::vector<float> & map);
+
+  // Number of maps written so far
+  unsigned long long num_maps() const { return _num_maps; }
+
+  // Finalize and close the file
+  void close();
+};
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,142 @@
+#include "param_design.hpp"
+
+#include "results_writer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Number of direction weights of each PMF
+static const unsigned int num_directions = 8;
+
+void ParamDesign::add(const DesignSpec & spec) {
+  DesignSpec checked = spec;
+  if (checked._type == design_type::one_direction) {
+    checked._num_points = num_directions;
+    if (!(checked._weight > 0)) {
+      throw std::runtime_error("Preferred direction weight must be positive");
+    }
+  }
+  else if (checked._num_points == 0) {
+    throw std::runtime_error("Designs need at least one point");
+  }
+  _specs.push_back(checked);
+  restart();
+}
+
+void ParamDesign::set_lambdas(const std::vector<double> & lambdas) {
+  if (lambdas.empty()) {
+    throw std::runtime_error("Designs need at least one lambda");
+  }
+  for (double lambda : lambdas) {
+    if (!(lambda > 0)) { throw std::runtime_error("Lambda must be positive"); }
+  }
+  _lambdas = lambdas;
+  restart();
+}
+
+void ParamDesign::set_marginal_rate(double rate) {
+  if (!(rate > 0)) {
+    throw std::runtime_error("Marginal rate must be positive");
+  }
+  _marginal_rate = rate;
+}
+
+uint64_t ParamDesign::size() const {
+  uint64_t num_points = 0;
+  for (const auto & spec : _specs) { num_points += spec._num_points; }
+  return num_points*_lambdas.size();
+}
+
+void ParamDesign::restart() {
+  _lambda_idx = 0;
+  _spec_idx = 0;
+  start_set();
+}
+
+// Every lambda replays the same direction PMFs, so each set is regenerated
+// from its seed rather than stored
+void ParamDesign::start_set() {
+  _point_idx = 0;
+  _sobol.reset();
+  _strata.clear();
+  if (_spec_idx >= _specs.size()) { return; }
+  const DesignSpec & spec = _specs[_spec_idx];
+  _rng.set_seed(spec._seed);
+  if (spec._type == design_type::sobol_design) {
+    _sobol = std::make_unique<Sobol>(num_directions);
+    _sobol->randomize(_rng);
+  }
+  else if (spec._type == design_type::latin_hypercube) {
+    // Shuffle the strata of each dimension independently
+    const uint32_t n = spec._num_points;
+    std::vector<uint32_t> strata(n);
+    _strata.resize(static_cast<size_t>(n)*num_directions);
+    for (unsigned int d = 0; d < num_directions; d++) {
+      std::iota(strata.begin(), strata.end(), 0);
+      for (uint32_t i = n; i > 1; i--) {
+        uint32_t j = std::min<uint32_t>(_rng.sample()*i, i-1);
+        std::swap(strata[i-1], strata[j]);
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        _strata[static_cast<size_t>(i)*num_directions + d] = strata[i];
+      }
+    }
+  }
+}
+
+// Inverse of the CDF (1-exp(-r x))/(1-exp(-r)) of the truncated exponential
+double ParamDesign::to_weight(double u) const {
+  return -std::log1p(-u*(-std::expm1(-_marginal_rate)))/_marginal_rate;
+}
+
+bool ParamDesign::next(double * params) {
+  while (_lambda_idx < _lambdas.size() &&
+         (_spec_idx >= _specs.size() ||
+          _point_idx >= _specs[_spec_idx]._num_points)) {
+    if (++_spec_idx >= _specs.size()) {
+      ++_lambda_idx;
+      _spec_idx = 0;
+    }
+    if (_lambda_idx < _lambdas.size()) { start_set(); }
+  }
+  if (_lambda_idx >= _lambdas.size() || _specs.empty()) { return false; }
+
+  const DesignSpec & spec = _specs[_spec_idx];
+  std::fill(params, params+num_PMF_params, 0.0);
+  if (spec._type == design_type::one_direction) {
+    std::fill(params, params+num_directions, 1.0);
+    params[_point_idx] = spec._weight;
+  }
+  else if (spec._type == design_type::sobol_design) {
+    const std::vector<double> & point = _sobol->next();
+    for (unsigned int d = 0; d < num_directions; d++) {
+      params[d] = to_weight(point[d]);
+    }
+  }
+  else {
+    const uint32_t * strata =
+      &_strata[static_cast<size_t>(_point_idx)*num_directions];
+    for (unsigned int d = 0; d < num_directions; d++) {
+      params[d] = to_weight((strata[d] + _rng.sample())/spec._num_points);
+    }
+  }
+  double total = std::accumulate(params, params+num_directions, 0.0);
+  for (unsigned int d = 0; d < num_directions; d++) { params[d] /= total; }
+  params[num_directions] = _lambdas[_lambda_idx];
+  ++_point_idx;
+  return true;
+}
+
+design_type to_design_type(const std::string & name) {
+  if (name == "lhs") { return design_type::latin_hypercube; }
+  if (name == "sobol") { return design_type::sobol_design; }
+  if (name == "one_direction") { return design_type::one_direction; }
+  throw std::runtime_error("Design "+name+" not recognized");
+}
+
+} // end namespace util
@@ -0,0 +1,101 @@
+#ifndef __PARAM_DESIGN_HEADER__
+#define __PARAM_DESIGN_HEADER__
+
+#include "rand.hpp"
+#include "sobol.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Enumerated list of designs of direction PMFs
+// latin_hypercube: Latin hypercube sample of the 8 direction weights
+// sobol_design: randomized Sobol points of the 8 direction weights
+// one_direction: one strongly preferred direction, once per direction
+enum design_type {latin_hypercube, sobol_design, one_direction};
+
+// Parameters of one set of direction PMFs of a design
+struct DesignSpec {
+  // Design of the set
+  design_type _type = design_type::latin_hypercube;
+  // Number of direction PMFs, always 8 for one_direction
+  unsigned int _num_points = 0;
+  // Seed of the random number generator
+  double _seed = 16180339;
+  // Weight of the preferred direction of one_direction PMFs, every other
+  // direction has weight 1
+  double _weight = 63;
+};
+
+// Generates the PMF parameter sets of a design of experiments one at a time,
+// so sweeps of any size need no input file. Every lambda of the sweep is
+// paired with every direction PMF of every set, lambda by lambda, each set
+// in the order it was added. Latin hypercube and Sobol weights are drawn
+// from exponential marginals of the marginal rate truncated to [0,1], and
+// every direction PMF is normalized to sum to 1. Generation is reproducible
+// for given seeds.
+class ParamDesign {
+private:
+  // Sets of direction PMFs in order
+  std::vector<DesignSpec> _specs;
+  // Distance PMF parameters of the sweep
+  std::vector<double> _lambdas = {1.0};
+  // Rate of the truncated exponential marginals of the direction weights
+  double _marginal_rate = 5.0;
+  // Position of the next parameter set
+  size_t _lambda_idx = 0;
+  size_t _spec_idx = 0;
+  unsigned int _point_idx = 0;
+  // Random number generator of the current set
+  RNG _rng;
+  // Sobol points of the current set, null for other designs
+  std::unique_ptr<Sobol> _sobol;
+  // Stratum of each point in each dimension of the current Latin hypercube,
+  // point major
+  std::vector<uint32_t> _strata;
+
+  // Restarts the generators of the current set from its seed
+  void start_set();
+
+  // Returns the direction weight at quantile u of the marginals
+  double to_weight(double u) const;
+
+public:
+  ParamDesign() {};
+  ~ParamDesign() {};
+
+  // Append a set of direction PMFs
+  void add(const DesignSpec & spec);
+
+  // Set the distance PMF parameters paired with every direction PMF
+  void set_lambdas(const std::vector<double> & lambdas);
+
+  // Set the rate of the truncated exponential marginals of the direction
+  // weights of Latin hypercube and Sobol designs
+  void set_marginal_rate(double rate);
+
+  // Total number of parameter sets
+  uint64_t size() const;
+
+  // True if no set of direction PMFs was added
+  bool empty() const { return _specs.empty(); }
+
+  // Writes the next 9 PMF parameters to params, returns false once every
+  // parameter set was generated
+  bool next(double * params);
+
+  // Restart the design from its first parameter set
+  void restart();
+};
+
+// Returns the design matching a design name,
+// "lhs", "sobol", or "one_direction"
+design_type to_design_type(const std::string & name);
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,57 @@
+#include "perf_counters.hpp"
+
+#include <iomanip>
+
+// Utility namespace
+namespace util {
+
+PerfCounters & perf_counters() {
+  static thread_local PerfCounters counters;
+  return counters;
+}
+
+// Writes a JSON array of the passed histogram
+static void write_histogram(
+    std::ostream & output_file, const unsigned long long * bins, int size) {
+  output_file << "[";
+  for (int i = 0; i < size; i++) {
+    output_file << (i == 0 ? "" : ",") << bins[i];
+  }
+  output_file << "]";
+}
+
+// Without compiled in counters the number of histories and steps are
+// deduced from the number of samples and the mean number of steps
+void PerfCounters::write_json(
+    std::ostream & output_file, int case_idx, double num_samples,
+    double mean, double wall_seconds) const {
+  double histories = perf_counters_enabled ? _histories : num_samples;
+  double steps = perf_counters_enabled ? _steps : mean*num_samples;
+  double rate_scale = wall_seconds > 0 ? 1.0/wall_seconds : 0.0;
+  double ns_per_step = steps > 0 ? 1e9*wall_seconds/steps : 0.0;
+
+  output_file << std::setprecision(10);
+  output_file << "{\"case\":" << case_idx;
+  output_file << ",\"counters_enabled\":"
+              << (perf_counters_enabled ? "true" : "false");
+  output_file << ",\"wall_seconds\":" << wall_seconds;
+  output_file << ",\"histories\":" << histories;
+  output_file << ",\"steps\":" << steps;
+  output_file << ",\"histories_per_sec\":" << histories*rate_scale;
+  output_file << ",\"steps_per_sec\":" << steps*rate_scale;
+  output_file << ",\"ns_per_step\":" << ns_per_step;
+  if (perf_counters_enabled) {
+    double sampling_ns = _direction_ns + _distance_ns;
+    output_file << ",\"direction_ns\":" << _direction_ns;
+    output_file << ",\"distance_ns\":" << _distance_ns;
+    output_file << ",\"direction_fraction\":"
+                << (sampling_ns > 0 ? _direction_ns/sampling_ns : 0.0);
+    output_file << ",\"run_lengths\":";
+    write_histogram(output_file, _run_lengths, max_run_length+1);
+    output_file << ",\"direction_counts\":";
+    write_histogram(output_file, _num_directions, num_direction_counts);
+  }
+  output_file << "}\n";
+}
+
+} // end namespace util
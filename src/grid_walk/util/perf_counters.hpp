@@ -0,0 +1,76 @@
+#ifndef __PERF_COUNTERS_HEADER__
+#define __PERF_COUNTERS_HEADER__
+
+#include <chrono>
+#include <ostream>
+
+// Hot path instrumentation is compiled in only when GRIDWALK_PERF_COUNTERS is
+// defined, otherwise PERF_COUNT statements compile to nothing
+#ifdef GRIDWALK_PERF_COUNTERS
+#define PERF_COUNT(statement) statement
+#else
+#define PERF_COUNT(statement)
+#endif
+
+// Utility namespace
+namespace util {
+
+// True if the hot path counters are compiled in
+#ifdef GRIDWALK_PERF_COUNTERS
+static const bool perf_counters_enabled = true;
+#else
+static const bool perf_counters_enabled = false;
+#endif
+
+// Counters accumulated over the walks of a single case
+struct PerfCounters {
+  // Number of run lengths with their own histogram bin, longer runs are
+  // tallied in the last bin
+  static const int max_run_length = 64;
+  // Number of possible reachable directions from a node, 0 through 8
+  static const int num_direction_counts = 9;
+
+  // Number of histories walked
+  unsigned long long _histories = 0;
+  // Number of steps taken
+  unsigned long long _steps = 0;
+  // Time spent sampling directions, including Grid::get_directions
+  double _direction_ns = 0;
+  // Time spent sampling distances, including Grid::get_distance
+  double _distance_ns = 0;
+  // Histogram of Grid::get_distance results
+  unsigned long long _run_lengths[max_run_length+1] = {};
+  // Histogram of the number of directions returned by Grid::get_directions
+  unsigned long long _num_directions[num_direction_counts] = {};
+
+  // Zero all counters
+  void clear() { *this = PerfCounters(); }
+
+  // Write the counters and derived rates of a case as a single line JSON
+  // object, wall_seconds is the wall clock time of the case
+  void write_json(
+    std::ostream & output_file, int case_idx, double num_samples,
+    double mean, double wall_seconds) const;
+};
+
+// Returns the counters of the calling thread
+PerfCounters & perf_counters();
+
+// Adds the lifetime of the timer in nanoseconds to the passed accumulator
+class ScopedTimer {
+private:
+  double & _total_ns;
+  std::chrono::steady_clock::time_point _start;
+
+public:
+  ScopedTimer(double & total_ns)
+    : _total_ns(total_ns), _start(std::chrono::steady_clock::now()) {};
+  ~ScopedTimer() {
+    _total_ns += std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - _start).count();
+  }
+};
+
+} // end namespace util
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __RAND_HEADER__
 #define __RAND_HEADER__
 
+#include <cstdint>
 #include <random>
 
 // Utility namespace
@@ -11,18 +12,64 @@ class RNG {
 private:
   std::mt19937_64 _engine;
   std::uniform_int_distribution<uint64_t> _int_dist;
+  // Numbers returned before the engine is sampled again, not owned
+  const double * _driven = nullptr;
+  unsigned int _num_driven = 0;
+  // Whether engine samples u are returned as 1-u
+  bool _antithetic = false;
+  // Engine samples drawn since the seed was set
+  uint64_t _num_samples = 0;
 
 public:
   RNG(double seed = 16180339) : _engine(seed) {};
   ~RNG() {};
 
   // Return a number uniformly distributed on [0,1]
-  double sample() { return (double) _int_dist(_engine)/UINT64_MAX; }
+  double sample() {
+    if (_num_driven > 0) {
+      --_num_driven;
+      return *_driven++;
+    }
+    ++_num_samples;
+    double u = (double) _int_dist(_engine)/UINT64_MAX;
+    return _antithetic ? 1.0-u : u;
+  }
+
+  // Return the n numbers at uniforms from the next n calls to sample, before
+  // returning to the engine. The numbers must outlive those calls.
+  void drive(const double * uniforms, unsigned int n) {
+    _driven = uniforms;
+    _num_driven = n;
+  }
+
+  // Set whether engine samples u are returned as 1-u
+  void set_antithetic(bool antithetic) { _antithetic = antithetic; }
+
+  // Number of engine samples drawn since the seed was set, copies of the
+  // same generator are at the same point of the stream if these are equal
+  uint64_t num_samples() const { return _num_samples; }
 
   // Sets the seed of the engine and resets the distribution
   void set_seed(double seed = 16180339) {
     _engine = std::mt19937_64(seed);
     _int_dist.reset();
+    _num_driven = 0;
+    _antithetic = false;
+    _num_samples = 0;
+  }
+
+  // Sets the engine to substream stream of the seed, substreams of the same
+  // seed are independent of each other
+  void set_seed(double seed, uint64_t stream) {
+    uint64_t bits = seed;
+    std::seed_seq sequence{
+      static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32),
+      static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)};
+    _engine.seed(sequence);
+    _int_dist.reset();
+    _num_driven = 0;
+    _antithetic = false;
+    _num_samples = 0;
   }
 };
 
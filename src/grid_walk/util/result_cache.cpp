@@ -0,0 +1,76 @@
+#include "result_cache.hpp"
+
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Magic string starting cache files
+static const char cache_magic[8] = {'G','W','C','A','C','H','E','2'};
+
+uint64_t CacheRecord::key() const {
+  // The inputs are the leading fields of the record
+  return fnv1a(this, offsetof(CacheRecord, _mean));
+}
+
+bool CacheRecord::same_case(const CacheRecord & other) const {
+  return std::memcmp(this, &other, offsetof(CacheRecord, _mean)) == 0;
+}
+
+ResultCache::ResultCache(const std::string & filename) {
+  load(filename);
+  _output_file.open(
+    filename, std::ios::out | std::ios::binary | std::ios::app);
+  if (!_output_file.is_open()) {
+    throw std::runtime_error("Failed to open result cache "+filename);
+  }
+  if (_output_file.tellp() == 0) {
+    _output_file.write(cache_magic, sizeof(cache_magic));
+    _output_file.flush();
+  }
+}
+
+// Cache File Format:
+// [magic] then records of sizeof(CacheRecord) bytes each
+// A partially written trailing record is ignored
+void ResultCache::load(const std::string & filename) {
+  std::ifstream input_file(filename, std::ios::in | std::ios::binary);
+  if (!input_file.is_open()) { return; }
+  char magic[sizeof(cache_magic)];
+  input_file.read(magic, sizeof(magic));
+  if (input_file.gcount() == 0) { return; }
+  if (input_file.gcount() != sizeof(magic) ||
+      !std::equal(magic, magic+sizeof(magic), cache_magic)) {
+    throw std::runtime_error("Not a result cache file: "+filename);
+  }
+  CacheRecord record;
+  while (input_file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    _records[record.key()] = record;
+  }
+}
+
+bool ResultCache::find(CacheRecord & record) {
+  auto cached = _records.find(record.key());
+  if (cached == _records.end() || !cached->second.same_case(record)) {
+    ++_num_misses;
+    return false;
+  }
+  ++_num_hits;
+  record = cached->second;
+  return true;
+}
+
+void ResultCache::insert(const CacheRecord & record) {
+  _records[record.key()] = record;
+  // Each record is written and flushed whole so concurrent runs appending
+  // to the same file do not interleave partial records
+  _output_file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  _output_file.flush();
+}
+
+} // end namespace util
@@ -0,0 +1,79 @@
+#ifndef __RESULT_CACHE_HEADER__
+#define __RESULT_CACHE_HEADER__
+
+#include "results_writer.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Version of the walk engine, part of every cache key. Increment whenever a
+// change alters the results of a walk for the same inputs so cached results
+// of the old engine are no longer returned.
+static const uint64_t engine_version = 2;
+
+// Single cached case, every field is 8 bytes so records have no padding
+struct CacheRecord {
+  // Inputs identifying the case
+  uint64_t _grid_hash = 0;
+  uint64_t _engine_version = engine_version;
+  // Hash of the walk options, such as the engine, that change results
+  uint64_t _options_hash = 0;
+  double _samples = 0;
+  double _seed = 0;
+  double _params[num_PMF_params] = {};
+  // Results of the case
+  double _mean = 0;
+  double _error = 0;
+  double _FOM = 0;
+  double _runtime = 0;
+
+  // Hash of the inputs used as the cache key
+  uint64_t key() const;
+  // True if the inputs of both records match
+  bool same_case(const CacheRecord & other) const;
+};
+
+// Persistent content addressed cache of case results. The cache file is an
+// append only log of fixed size records, loaded into memory when opened and
+// appended to as new cases complete, so several runs may share one file.
+class ResultCache {
+private:
+  // Records by key
+  std::unordered_map<uint64_t, CacheRecord> _records;
+  // Cache file opened for appending
+  std::ofstream _output_file;
+  // Number of lookups that found a result and that did not
+  unsigned long long _num_hits = 0;
+  unsigned long long _num_misses = 0;
+
+  // Read the records of an existing cache file
+  void load(const std::string & filename);
+
+public:
+  // Opens the cache file, creating it if it does not exist
+  ResultCache(const std::string & filename);
+  ~ResultCache() {};
+
+  // Fill the results of record if a case with the same inputs is cached,
+  // returns true if found
+  bool find(CacheRecord & record);
+
+  // Add a completed case and append it to the cache file
+  void insert(const CacheRecord & record);
+
+  // Number of cached cases
+  size_t size() const { return _records.size(); }
+
+  unsigned long long num_hits() const { return _num_hits; }
+  unsigned long long num_misses() const { return _num_misses; }
+};
+
+} // end namespace util
+
+#endif
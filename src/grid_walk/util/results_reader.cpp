@@ -0,0 +1,133 @@
+#include "results_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRIDWALK_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Utility namespace
+namespace util {
+
+// Armadillo binary header for a matrix of doubles
+static const char arma_header[] = "ARMA_MAT_BIN_FN008";
+
+ResultsReader::ResultsReader(const std::string & filename) :
+    _filename(filename) {
+  _input_file.open(filename, std::ios::in | std::ios::binary);
+  if (!_input_file.is_open()) {
+    throw std::runtime_error("Failed to open results file "+filename);
+  }
+  char magic[sizeof(arma_header)-1];
+  _input_file.read(magic, sizeof(magic));
+  _binary = _input_file.gcount() == sizeof(magic) &&
+    std::memcmp(magic, arma_header, sizeof(magic)) == 0;
+  _input_file.clear();
+  _input_file.seekg(0);
+  if (_binary) { open_binary(); }
+  else { open_csv(); }
+}
+
+// Binary File Format:
+// ARMA_MAT_BIN_FN008\n[num_columns] [num_cases]\n
+// then num_cases records of num_columns doubles
+void ResultsReader::open_binary() {
+  std::string header;
+  _input_file >> header >> _num_columns >> _num_cases;
+  _input_file.get();
+  if (!_input_file || _num_columns == 0) {
+    throw std::runtime_error("Invalid results file header in "+_filename);
+  }
+  _data_offset = _input_file.tellg();
+#ifdef GRIDWALK_HAS_MMAP
+  int fd = ::open(_filename.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd >= 0 && fstat(fd, &info) == 0) {
+    size_t size = _data_offset + _num_cases*_num_columns*sizeof(double);
+    if (static_cast<size_t>(info.st_size) >= size && size > 0) {
+      void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        _mapping = static_cast<const char *>(mapping);
+        _mapping_size = size;
+      }
+    }
+  }
+  if (fd >= 0) { ::close(fd); }
+  if (_mapping) { _input_file.close(); }
+#endif
+}
+
+void ResultsReader::open_csv() {
+  std::string line;
+  while (std::getline(_input_file, line) && line.find(',') == line.npos) {}
+  _num_columns = 1;
+  for (char c : line) { _num_columns += (c == ','); }
+  rewind();
+}
+
+void ResultsReader::close() {
+#ifdef GRIDWALK_HAS_MMAP
+  if (_mapping) {
+    munmap(const_cast<char *>(_mapping), _mapping_size);
+    _mapping = nullptr;
+  }
+#endif
+  if (_input_file.is_open()) { _input_file.close(); }
+}
+
+size_t ResultsReader::read_batch(
+    size_t max_cases, std::vector<double> & batch) {
+  batch.resize(max_cases*_num_columns);
+  size_t num_read = 0;
+  if (_binary) {
+    num_read = std::min<unsigned long long>(max_cases, _num_cases-_next_case);
+    size_t num_bytes = num_read*_num_columns*sizeof(double);
+    if (_mapping) {
+      std::memcpy(batch.data(), _mapping + _data_offset +
+                  _next_case*_num_columns*sizeof(double), num_bytes);
+    }
+    else {
+      _input_file.read(reinterpret_cast<char *>(batch.data()), num_bytes);
+      if (!_input_file) {
+        throw std::runtime_error("Results file is truncated: "+_filename);
+      }
+    }
+    _next_case += num_read;
+  }
+  else {
+    std::string line;
+    std::string value;
+    while (num_read < max_cases && std::getline(_input_file, line)) {
+      if (line.find(',') == line.npos) { continue; }
+      std::stringstream line_stream(line);
+      double * row = batch.data() + num_read*_num_columns;
+      for (unsigned int i = 0; i < _num_columns; i++) {
+        if (!std::getline(line_stream, value, ',')) {
+          throw std::runtime_error("Results row has too few values: "+line);
+        }
+        row[i] = std::stod(value);
+      }
+      ++num_read;
+    }
+  }
+  batch.resize(num_read*_num_columns);
+  return num_read;
+}
+
+void ResultsReader::rewind() {
+  _next_case = 0;
+  if (_input_file.is_open()) {
+    _input_file.clear();
+    _input_file.seekg(_binary ? _data_offset : 0);
+  }
+}
+
+} // end namespace util
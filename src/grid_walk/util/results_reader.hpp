@@ -0,0 +1,67 @@
+#ifndef __RESULTS_READER_HEADER__
+#define __RESULTS_READER_HEADER__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Reads results files written by ResultsWriter in batches of cases without
+// loading the whole file. Binary files are memory mapped where supported and
+// read through a stream otherwise, CSV files are streamed line by line.
+class ResultsReader {
+private:
+  // Name of the file being read
+  std::string _filename;
+  // True for armadillo binary files, false for CSV
+  bool _binary = false;
+  // Number of values per case
+  unsigned int _num_columns = 0;
+  // Number of cases in a binary file, CSV files are not counted up front
+  unsigned long long _num_cases = 0;
+  // Index of the next case of a binary file
+  unsigned long long _next_case = 0;
+  // Offset of the first case of a binary file
+  std::streamoff _data_offset = 0;
+  // Memory mapping of a binary file, null when the file is streamed
+  const char * _mapping = nullptr;
+  // Size of the memory mapping in bytes
+  size_t _mapping_size = 0;
+  // Stream used when the file is not memory mapped
+  std::ifstream _input_file;
+
+  // Read the binary header and map the file
+  void open_binary();
+  // Count the columns of the first CSV row
+  void open_csv();
+  // Unmap or close the file
+  void close();
+
+public:
+  ResultsReader(const std::string & filename);
+  ~ResultsReader() { close(); }
+  ResultsReader(const ResultsReader &) = delete;
+  ResultsReader & operator=(const ResultsReader &) = delete;
+
+  // Number of values per case
+  unsigned int num_columns() const { return _num_columns; }
+
+  // Number of cases of a binary file, 0 for CSV files
+  unsigned long long num_cases() const { return _num_cases; }
+
+  // True if the file is memory mapped
+  bool is_mapped() const { return _mapping != nullptr; }
+
+  // Read up to max_cases cases into batch, num_columns values per case one
+  // case after another. Returns the number of cases read, 0 at end of file.
+  size_t read_batch(size_t max_cases, std::vector<double> & batch);
+
+  // Start again from the first case
+  void rewind();
+};
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,90 @@
+#include "results_writer.hpp"
+
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Armadillo binary header for a matrix of doubles
+static const char arma_header[] = "ARMA_MAT_BIN_FN008";
+
+// Width of the zero padded case count so the header can be rewritten in place
+static const int count_width = 20;
+
+ResultsWriter::ResultsWriter(
+    const std::string & filename, results_format format) : _format(format) {
+  if (_format == results_format::binary) {
+    _output_file.open(filename, std::ios::out | std::ios::binary);
+    if (!_output_file.is_open()) { return; }
+    // Each case is a column so records are contiguous in column major order
+    _output_file << arma_header << "\n" << num_result_columns << " ";
+    _count_pos = _output_file.tellp();
+    _output_file << std::setw(count_width) << std::setfill('0') << 0 << "\n";
+    _output_file << std::setfill(' ');
+  }
+  else {
+    _output_file.open(filename);
+    if (!_output_file.is_open()) { return; }
+    _output_file << std::setprecision(10);
+  }
+  _output_file.flush();
+}
+
+void ResultsWriter::update_header() {
+  auto end = _output_file.tellp();
+  _output_file.seekp(_count_pos);
+  _output_file << std::setw(count_width) << std::setfill('0') << _num_cases;
+  _output_file << std::setfill(' ');
+  _output_file.seekp(end);
+}
+
+void ResultsWriter::write(const CaseResult & result) {
+  if (!_output_file.is_open()) {
+    throw std::runtime_error("Results file is not open");
+  }
+  double row[num_result_columns];
+  to_result_row(result, row);
+
+  ++_num_cases;
+  if (_format == results_format::binary) {
+    _output_file.write(reinterpret_cast<const char *>(row), sizeof(row));
+    update_header();
+  }
+  else {
+    for (int i = 0; i < num_result_columns-1; i++) {
+      _output_file << row[i] << ",";
+    }
+    _output_file << row[num_result_columns-1] << "\n";
+  }
+  _output_file.flush();
+}
+
+void ResultsWriter::close() {
+  if (_output_file.is_open()) {
+    _output_file.close();
+  }
+}
+
+void to_result_row(const CaseResult & result, double * row) {
+  // Total the direction PMF parameters to normalize
+  double total = std::accumulate(
+    result._params, result._params+num_PMF_params-1, 0.0);
+  for (int i = 0; i < num_PMF_params-1; i++) {
+    row[i] = result._params[i]/total;
+  }
+  row[num_PMF_params-1] = result._params[num_PMF_params-1];
+  row[num_PMF_params] = result._mean;
+  row[num_PMF_params+1] = result._error;
+  row[num_PMF_params+2] = result._samples;
+  row[num_PMF_params+3] = result._runtime;
+}
+
+results_format to_results_format(const std::string & name) {
+  if (name == "csv") { return results_format::csv; }
+  if (name == "binary") { return results_format::binary; }
+  throw std::runtime_error("Results format "+name+" not recognized");
+}
+
+} // end namespace util
@@ -0,0 +1,93 @@
+#ifndef __RESULTS_WRITER_HEADER__
+#define __RESULTS_WRITER_HEADER__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Number of PMF parameters describing a walk, 8 directions and 1 distance
+static const int num_PMF_params = 9;
+
+// Number of columns written per case
+// [direction pmf] [distance pmf] mean error samples runtime
+static const int num_result_columns = num_PMF_params + 4;
+
+// Enumerated list of supported results file formats
+// csv: comma separated text, loadable with arma::csv_ascii
+// binary: armadillo arma_binary matrix with one column per case, loadable
+//         with arma::arma_binary without transposing
+enum results_format {csv, binary};
+
+// Results of a single Monte Carlo case
+struct CaseResult {
+  // Direction PMF followed by the distance PMF parameter
+  // Direction information is stored in the order:
+  // north, north_east, east, south_east,
+  // south, south_west, west, north_west
+  double _params[num_PMF_params];
+  // Estimate of the mean number of steps to the goal
+  double _mean = 0;
+  // Standard deviation of the estimate of the mean
+  double _error = 0;
+  // Number of histories simulated
+  double _samples = 0;
+  // Wall clock time of the case in seconds
+  double _runtime = 0;
+};
+
+// Interface of all consumers of case results, results are passed to write as
+// each case completes
+class ResultsSink {
+public:
+  virtual ~ResultsSink() {};
+
+  // Consume the results of a single case
+  virtual void write(const CaseResult & result) = 0;
+};
+
+// Streams case results to file as each case completes so that no results
+// are held in memory. Direction PMF values are normalized on output.
+class ResultsWriter : public ResultsSink {
+private:
+  // File being written to
+  std::ofstream _output_file;
+  // Format of the file
+  results_format _format;
+  // Number of cases written so far
+  unsigned long long _num_cases = 0;
+  // Position of the case count in the binary header
+  std::streampos _count_pos;
+
+  // Rewrites the number of cases in the binary header
+  void update_header();
+
+public:
+  ResultsWriter(const std::string & filename, results_format format);
+  ~ResultsWriter() { close(); }
+
+  // True if the output file was opened successfully
+  bool is_open() const { return _output_file.is_open(); }
+
+  // Write a single case and flush it to disk
+  void write(const CaseResult & result) override;
+
+  // Number of cases written so far
+  unsigned long long num_cases() const { return _num_cases; }
+
+  // Finalize and close the file
+  void close();
+};
+
+// Fills row with the num_result_columns values written for a case, with the
+// direction PMF normalized
+void to_result_row(const CaseResult & result, double * row);
+
+// Returns the results format matching a format name, "csv" or "binary"
+results_format to_results_format(const std::string & name);
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,115 @@
+#include "scaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Names of the scalings in the order of the enum
+static const char * scaling_names[] = {"none", "minmax", "standard"};
+
+Scaler::Scaler(unsigned int num_columns, scaling type) :
+    _scaling(type), _num_columns(num_columns),
+    _min(num_columns, std::numeric_limits<double>::max()),
+    _max(num_columns, std::numeric_limits<double>::lowest()),
+    _mean(num_columns, 0), _m2(num_columns, 0),
+    _scale(num_columns, 1), _offset(num_columns, 0) {}
+
+void Scaler::fit_batch(
+    const double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column) {
+  for (size_t r = 0; r < num_rows; r++) {
+    const double * row = batch + r*stride + first_column;
+    ++_count;
+    for (unsigned int i = 0; i < _num_columns; i++) {
+      _min[i] = std::min(_min[i], row[i]);
+      _max[i] = std::max(_max[i], row[i]);
+      // Welford update of the mean and sum of squared deviations
+      double delta = row[i] - _mean[i];
+      _mean[i] += delta/_count;
+      _m2[i] += delta*(row[i] - _mean[i]);
+    }
+  }
+}
+
+void Scaler::finalize() {
+  for (unsigned int i = 0; i < _num_columns; i++) {
+    double center = 0;
+    double width = 1;
+    if (_count > 0 && _scaling == scaling::min_max_scaling) {
+      center = _min[i];
+      width = _max[i] - _min[i];
+    }
+    else if (_count > 0 && _scaling == scaling::standard_scaling) {
+      center = _mean[i];
+      width = std::sqrt(_m2[i]/_count);
+    }
+    // Constant columns are only shifted
+    if (!(width > 0)) { width = 1; }
+    _scale[i] = 1/width;
+    _offset[i] = -center/width;
+  }
+}
+
+void Scaler::transform(
+    double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column) const {
+  for (size_t r = 0; r < num_rows; r++) {
+    double * row = batch + r*stride + first_column;
+    for (unsigned int i = 0; i < _num_columns; i++) {
+      row[i] = row[i]*_scale[i] + _offset[i];
+    }
+  }
+}
+
+void Scaler::inverse_transform(
+    double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column) const {
+  for (size_t r = 0; r < num_rows; r++) {
+    double * row = batch + r*stride + first_column;
+    for (unsigned int i = 0; i < _num_columns; i++) {
+      row[i] = (row[i] - _offset[i])/_scale[i];
+    }
+  }
+}
+
+// Scaler File Format:
+// Scaling [name]
+// Columns [num_columns]
+// [scale] [offset] for each column
+void Scaler::read(std::istream & input_file) {
+  std::string label, name;
+  input_file >> label >> name;
+  _scaling = to_scaling(name);
+  input_file >> label >> _num_columns;
+  _scale.resize(_num_columns);
+  _offset.resize(_num_columns);
+  for (unsigned int i = 0; i < _num_columns; i++) {
+    input_file >> _scale[i] >> _offset[i];
+  }
+  if (!input_file) {
+    throw std::runtime_error("Failed to read scaler");
+  }
+}
+
+void Scaler::write(std::ostream & output_file) const {
+  output_file << "Scaling " << scaling_names[_scaling] << "\n";
+  output_file << "Columns " << _num_columns << "\n";
+  output_file << std::setprecision(17);
+  for (unsigned int i = 0; i < _num_columns; i++) {
+    output_file << _scale[i] << " " << _offset[i] << "\n";
+  }
+}
+
+scaling to_scaling(const std::string & name) {
+  for (int i = 0; i < 3; i++) {
+    if (name == scaling_names[i]) { return static_cast<scaling>(i); }
+  }
+  throw std::runtime_error("Scaling "+name+" not recognized");
+}
+
+} // end namespace util
@@ -0,0 +1,71 @@
+#ifndef __SCALER_HEADER__
+#define __SCALER_HEADER__
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Enumerated list of supported feature scalings
+// min_max: each column mapped to [0, 1]
+// standard: each column shifted to zero mean and unit standard deviation
+enum scaling {no_scaling, min_max_scaling, standard_scaling};
+
+// Per column affine scaling x' = x*scale + offset, fitted from batches of
+// rows so the data never has to be held in memory at once
+class Scaler {
+private:
+  // Scaling being fitted
+  scaling _scaling;
+  // Number of columns scaled
+  unsigned int _num_columns;
+  // Running statistics of each column
+  unsigned long long _count = 0;
+  std::vector<double> _min;
+  std::vector<double> _max;
+  std::vector<double> _mean;
+  std::vector<double> _m2;
+  // Fitted transform of each column
+  std::vector<double> _scale;
+  std::vector<double> _offset;
+
+public:
+  Scaler(unsigned int num_columns = 0, scaling type = no_scaling);
+  ~Scaler() {};
+
+  // Update the statistics with num_rows rows of a batch, stride values apart,
+  // scaling the num_columns values starting at first_column of each row
+  void fit_batch(
+    const double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column = 0);
+
+  // Compute the transform from the statistics gathered so far
+  void finalize();
+
+  // Scale the num_columns values starting at first_column of each row in
+  // place, or undo the scaling
+  void transform(
+    double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column = 0) const;
+  void inverse_transform(
+    double * batch, size_t num_rows, unsigned int stride,
+    unsigned int first_column = 0) const;
+
+  unsigned int num_columns() const { return _num_columns; }
+  const std::vector<double> & get_scale() const { return _scale; }
+  const std::vector<double> & get_offset() const { return _offset; }
+
+  // Read or write the fitted transform as text
+  void read(std::istream & input_file);
+  void write(std::ostream & output_file) const;
+};
+
+// Returns the scaling matching a name, "none", "minmax", or "standard"
+scaling to_scaling(const std::string & name);
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,126 @@
+#include "shard_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Utility namespace
+namespace util {
+
+// Magic string starting shard files
+static const char shard_magic[8] = {'G','W','S','H','A','R','D','2'};
+
+void ShardRecord::merge(const ShardRecord & other) {
+  _runtime += other._runtime;
+  _moments.merge(other._moments);
+  if (_visits.empty()) {
+    _visits = other._visits;
+  }
+  else if (!other._visits.empty()) {
+    if (_visits.size() != other._visits.size()) {
+      throw std::runtime_error("Shard visit tallies differ in size");
+    }
+    for (size_t i = 0; i < _visits.size(); i++) {
+      _visits[i] += other._visits[i];
+    }
+  }
+}
+
+// Shard File Format:
+// [magic] [ShardHeader]
+// then for each case
+// [case_idx] [params] [runtime] [WalkMoments] [uint64 num_visits] [visits]
+ShardWriter::ShardWriter(
+    const std::string & filename, const ShardHeader & header) {
+  _output_file.open(filename, std::ios::out | std::ios::binary);
+  if (!_output_file.is_open()) { return; }
+  _output_file.write(shard_magic, sizeof(shard_magic));
+  _output_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  _output_file.flush();
+}
+
+void ShardWriter::write(const ShardRecord & record) {
+  if (!_output_file.is_open()) {
+    throw std::runtime_error("Shard file is not open");
+  }
+  _output_file.write(
+    reinterpret_cast<const char *>(&record._case_idx),
+    sizeof(record._case_idx));
+  _output_file.write(
+    reinterpret_cast<const char *>(record._params), sizeof(record._params));
+  _output_file.write(
+    reinterpret_cast<const char *>(&record._runtime),
+    sizeof(record._runtime));
+  _output_file.write(
+    reinterpret_cast<const char *>(&record._moments),
+    sizeof(record._moments));
+  uint64_t num_visits = record._visits.size();
+  _output_file.write(
+    reinterpret_cast<const char *>(&num_visits), sizeof(num_visits));
+  _output_file.write(
+    reinterpret_cast<const char *>(record._visits.data()),
+    num_visits*sizeof(uint64_t));
+  _output_file.flush();
+}
+
+ShardReader::ShardReader(const std::string & filename) {
+  _input_file.open(filename, std::ios::in | std::ios::binary);
+  if (!_input_file.is_open()) {
+    throw std::runtime_error("Failed to open shard file "+filename);
+  }
+  char magic[sizeof(shard_magic)];
+  _input_file.read(magic, sizeof(magic));
+  _input_file.read(reinterpret_cast<char *>(&_header), sizeof(_header));
+  if (!_input_file ||
+      !std::equal(magic, magic+sizeof(magic), shard_magic)) {
+    throw std::runtime_error("Not a shard file: "+filename);
+  }
+  if (_header._num_shards == 0 || _header._shard >= _header._num_shards) {
+    throw std::runtime_error("Shard index out of range in "+filename);
+  }
+}
+
+bool ShardReader::read(ShardRecord & record) {
+  if (!_input_file.read(
+        reinterpret_cast<char *>(&record._case_idx),
+        sizeof(record._case_idx))) {
+    return false;
+  }
+  _input_file.read(
+    reinterpret_cast<char *>(record._params), sizeof(record._params));
+  _input_file.read(
+    reinterpret_cast<char *>(&record._runtime), sizeof(record._runtime));
+  _input_file.read(
+    reinterpret_cast<char *>(&record._moments), sizeof(record._moments));
+  uint64_t num_visits = 0;
+  _input_file.read(
+    reinterpret_cast<char *>(&num_visits), sizeof(num_visits));
+  record._visits.resize(num_visits);
+  _input_file.read(
+    reinterpret_cast<char *>(record._visits.data()),
+    num_visits*sizeof(uint64_t));
+  if (!_input_file) {
+    throw std::runtime_error("Shard file is truncated");
+  }
+  return true;
+}
+
+void to_shard(const std::string & spec, unsigned int & shard,
+              unsigned int & num_shards) {
+  size_t slash = spec.find('/');
+  if (slash == spec.npos) {
+    throw std::runtime_error("Shard must be given as i/N, not "+spec);
+  }
+  shard = std::stoul(spec.substr(0, slash));
+  num_shards = std::stoul(spec.substr(slash+1));
+  if (num_shards == 0 || shard >= num_shards) {
+    throw std::runtime_error("Shard "+spec+" is out of range");
+  }
+}
+
+shard_mode to_shard_mode(const std::string & name) {
+  if (name == "histories") { return shard_mode::shard_histories; }
+  if (name == "entries") { return shard_mode::shard_entries; }
+  throw std::runtime_error("Shard mode "+name+" not recognized");
+}
+
+} // end namespace util
@@ -0,0 +1,93 @@
+#ifndef __SHARD_FILE_HEADER__
+#define __SHARD_FILE_HEADER__
+
+#include "results_writer.hpp"
+#include "walk_moments.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Enumerated list of ways to split a walk parameters file across shards
+// histories: every shard walks its chunks of the histories of every case
+// entries: every shard walks all histories of its share of the cases
+enum shard_mode {shard_histories, shard_entries};
+
+// Settings shared by all shards of a run, checked for consistency on merge
+struct ShardHeader {
+  uint64_t _shard = 0;
+  uint64_t _num_shards = 1;
+  uint64_t _mode = shard_mode::shard_histories;
+  // Cases in the run, and records written by this shard
+  uint64_t _num_cases = 0;
+  uint64_t _num_records = 0;
+  uint64_t _engine_version = 0;
+  uint64_t _grid_hash = 0;
+  uint64_t _options_hash = 0;
+  uint64_t _x_dim = 0;
+  uint64_t _y_dim = 0;
+  double _num_samples = 0;
+  double _seed = 0;
+  double _max_steps = 0;
+};
+
+// Partial results of one case walked by a shard
+struct ShardRecord {
+  // Index of the case in the walk parameters file, 0 is the analog case
+  uint64_t _case_idx = 0;
+  double _params[num_PMF_params] = {};
+  // Wall clock time spent by the shard
+  double _runtime = 0;
+  WalkMoments _moments;
+  // Raw visits of every node row by row, empty if the case was not tracked
+  std::vector<uint64_t> _visits;
+
+  // Add the partial results of the same case from another shard
+  void merge(const ShardRecord & other);
+};
+
+// Writes the partial results of a shard, each record is flushed whole
+class ShardWriter {
+private:
+  std::ofstream _output_file;
+
+public:
+  ShardWriter(const std::string & filename, const ShardHeader & header);
+  ~ShardWriter() {};
+
+  bool is_open() const { return _output_file.is_open(); }
+
+  void write(const ShardRecord & record);
+};
+
+// Reads the partial results written by ShardWriter
+class ShardReader {
+private:
+  std::ifstream _input_file;
+  ShardHeader _header;
+
+public:
+  // Throws if the file is not a shard file or its shard index is out of range
+  ShardReader(const std::string & filename);
+  ~ShardReader() {};
+
+  const ShardHeader & header() const { return _header; }
+
+  // Read the next record, returns false at the end of the file
+  bool read(ShardRecord & record);
+};
+
+// Parses a shard specification "i/N" into the shard index and count
+void to_shard(const std::string & spec, unsigned int & shard,
+              unsigned int & num_shards);
+
+// Returns the shard mode matching a name, "histories" or "entries"
+shard_mode to_shard_mode(const std::string & name);
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,96 @@
+#include "sobol.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Utility namespace
+namespace util {
+
+// Primitive polynomials and initial direction numbers of dimensions 2 to 21
+// from the new-joe-kuo-6.21201 table of Joe and Kuo: degree s, coefficients
+// a, then the s odd initial direction numbers m_1 ... m_s
+struct SobolPolynomial {
+  unsigned int _degree;
+  unsigned int _coefficients;
+  unsigned int _initial[7];
+};
+static const SobolPolynomial sobol_polynomials[Sobol::max_dimensions-1] = {
+  {1,  0, {1}},
+  {2,  1, {1, 3}},
+  {3,  1, {1, 3, 1}},
+  {3,  2, {1, 1, 1}},
+  {4,  1, {1, 1, 3, 3}},
+  {4,  4, {1, 3, 5, 13}},
+  {5,  2, {1, 1, 5, 5, 17}},
+  {5,  4, {1, 1, 5, 5, 5}},
+  {5,  7, {1, 1, 7, 11, 19}},
+  {5, 11, {1, 1, 5, 1, 1}},
+  {5, 13, {1, 1, 1, 3, 11}},
+  {5, 14, {1, 3, 5, 5, 31}},
+  {6,  1, {1, 3, 3, 9, 7, 49}},
+  {6, 13, {1, 1, 1, 15, 21, 21}},
+  {6, 16, {1, 3, 1, 13, 27, 49}},
+  {6, 19, {1, 1, 1, 15, 7, 5}},
+  {6, 22, {1, 3, 1, 15, 13, 25}},
+  {6, 25, {1, 1, 5, 5, 19, 61}},
+  {7,  1, {1, 3, 7, 11, 23, 15, 103}},
+  {7,  4, {1, 3, 7, 13, 13, 15, 69}}};
+
+Sobol::Sobol(unsigned int dimensions)
+    : _dimensions(dimensions), _directions(32*dimensions),
+      _state(dimensions, 0), _shift(dimensions, 0), _point(dimensions) {
+  if (dimensions == 0 || dimensions > max_dimensions) {
+    throw std::runtime_error(
+      "Sobol sequences support 1 to "+std::to_string(max_dimensions)+
+      " dimensions");
+  }
+  // The first dimension is the van der Corput sequence
+  for (unsigned int k = 0; k < 32; k++) { _directions[k] = 1u << (31-k); }
+  for (unsigned int d = 1; d < dimensions; d++) {
+    const SobolPolynomial & poly = sobol_polynomials[d-1];
+    const unsigned int s = poly._degree;
+    uint32_t * v = _directions.data() + 32*d;
+    for (unsigned int k = 0; k < s; k++) {
+      v[k] = poly._initial[k] << (31-k);
+    }
+    for (unsigned int k = s; k < 32; k++) {
+      v[k] = v[k-s] ^ (v[k-s] >> s);
+      for (unsigned int j = 1; j < s; j++) {
+        if ((poly._coefficients >> (s-1-j)) & 1) { v[k] ^= v[k-j]; }
+      }
+    }
+  }
+}
+
+void Sobol::randomize(RNG & rng) {
+  for (auto & shift : _shift) {
+    shift = static_cast<uint32_t>(rng.sample()*4294967295.0);
+  }
+  std::fill(_state.begin(), _state.end(), 0);
+  _index = 0;
+}
+
+// Gray code order, each point flips the direction number of the lowest zero
+// bit of the previous index. Points sit at the centre of their 2^-32 cell so
+// no coordinate is exactly 0 or 1.
+const std::vector<double> & Sobol::next() {
+  if (_index > 0) {
+    uint32_t previous = _index-1;
+    unsigned int bit = 0;
+    while (previous & 1) { previous >>= 1; ++bit; }
+    if (bit >= 32) {
+      throw std::runtime_error("Sobol sequence exhausted");
+    }
+    for (unsigned int d = 0; d < _dimensions; d++) {
+      _state[d] ^= _directions[32*d+bit];
+    }
+  }
+  ++_index;
+  for (unsigned int d = 0; d < _dimensions; d++) {
+    _point[d] = ((_state[d] ^ _shift[d]) + 0.5) / 4294967296.0;
+  }
+  return _point;
+}
+
+} // end namespace util
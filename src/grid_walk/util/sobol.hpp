@@ -0,0 +1,57 @@
+#ifndef __SOBOL_HEADER__
+#define __SOBOL_HEADER__
+
+#include "rand.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Enumerated list of the ways histories sample their decisions: independent
+// pseudorandom numbers, antithetic pairs of histories, or randomized Sobol
+// points driving the first decisions of each history
+enum sampling {random_sampling, antithetic_sampling, sobol_sampling};
+
+// Sobol low discrepancy sequence randomized by a random digital shift. Each
+// randomization XORs every coordinate with its own random 32 bit shift, so
+// the points of one randomization are uniformly distributed while keeping
+// their low discrepancy, and independent randomizations give an unbiased
+// estimate of the error.
+class Sobol {
+public:
+  // Largest number of dimensions with direction numbers
+  static const unsigned int max_dimensions = 21;
+
+private:
+  // Number of dimensions of each point
+  unsigned int _dimensions;
+  // Direction numbers, 32 per dimension
+  std::vector<uint32_t> _directions;
+  // Unshifted integer coordinates of the current point
+  std::vector<uint32_t> _state;
+  // Digital shift of each dimension
+  std::vector<uint32_t> _shift;
+  // Coordinates of the current point on (0,1)
+  std::vector<double> _point;
+  // Index of the next point
+  uint32_t _index = 0;
+
+public:
+  Sobol(unsigned int dimensions);
+  ~Sobol() {};
+
+  // Draws a new digital shift from rng and restarts the sequence
+  void randomize(RNG & rng);
+
+  // Returns the next point, valid until the next call
+  const std::vector<double> & next();
+
+  // Number of dimensions of each point
+  unsigned int dimensions() const { return _dimensions; }
+};
+
+} // end namespace util
+
+#endif
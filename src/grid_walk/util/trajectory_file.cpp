@@ -0,0 +1,166 @@
+#include "trajectory_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRIDWALK_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Utility namespace
+namespace util {
+
+// Magic string starting and ending trajectory files
+static const char trajectory_magic[8] = {'G','W','T','R','A','J','0','1'};
+
+// Footer locating the index and case table
+struct TrajectoryFooter {
+  uint64_t _index_offset = 0;
+  uint64_t _num_histories = 0;
+  uint64_t _num_cases = 0;
+  char _magic[sizeof(trajectory_magic)] = {};
+};
+
+// Trajectory File Format:
+// [magic] [TrajectoryHeader]
+// then the coded moves of every history, one history after another
+// [zero padding to 8 bytes] [TrajectoryIndex of every history]
+// [TrajectoryCase of every case] [TrajectoryFooter]
+TrajectoryWriter::TrajectoryWriter(
+    const std::string & filename, const TrajectoryHeader & header) {
+  _output_file.open(filename, std::ios::out | std::ios::binary);
+  if (!_output_file.is_open()) { return; }
+  _output_file.write(trajectory_magic, sizeof(trajectory_magic));
+  _output_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  _offset = sizeof(trajectory_magic) + sizeof(header);
+}
+
+void TrajectoryWriter::begin_case(
+    uint64_t case_idx, const std::vector<double> & params) {
+  if (params.size() != num_PMF_params) {
+    throw std::runtime_error(
+      "Trajectory cases need "+std::to_string(num_PMF_params)+" parameters");
+  }
+  TrajectoryCase trajectory_case;
+  trajectory_case._case_idx = case_idx;
+  std::copy(params.begin(), params.end(), trajectory_case._params);
+  trajectory_case._first_history = _index.size();
+  _cases.push_back(trajectory_case);
+}
+
+void TrajectoryWriter::end_history() {
+  if (!_output_file.is_open()) {
+    throw std::runtime_error("Trajectory file is not open");
+  }
+  if (_cases.empty()) {
+    throw std::runtime_error("Trajectory recorded before its case began");
+  }
+  TrajectoryIndex entry;
+  entry._offset = _offset;
+  entry._num_moves = _num_moves;
+  entry._case = _cases.size()-1;
+  _index.push_back(entry);
+  ++_cases.back()._num_histories;
+  _output_file.write(
+    reinterpret_cast<const char *>(_moves.data()), _moves.size());
+  _offset += _moves.size();
+  _moves.clear();
+  _num_moves = 0;
+}
+
+void TrajectoryWriter::close() {
+  if (!_output_file.is_open()) { return; }
+  const char padding[8] = {};
+  _output_file.write(padding, (8 - _offset % 8) % 8);
+  TrajectoryFooter footer;
+  footer._index_offset = _offset + (8 - _offset % 8) % 8;
+  footer._num_histories = _index.size();
+  footer._num_cases = _cases.size();
+  std::copy(trajectory_magic, trajectory_magic+sizeof(trajectory_magic),
+            footer._magic);
+  _output_file.write(reinterpret_cast<const char *>(_index.data()),
+                     _index.size()*sizeof(TrajectoryIndex));
+  _output_file.write(reinterpret_cast<const char *>(_cases.data()),
+                     _cases.size()*sizeof(TrajectoryCase));
+  _output_file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+  _output_file.close();
+}
+
+TrajectoryReader::TrajectoryReader(const std::string & filename) {
+#ifdef GRIDWALK_HAS_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+    void * mapping =
+      mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      _data = static_cast<const uint8_t *>(mapping);
+      _size = info.st_size;
+      _mapped = true;
+    }
+  }
+  if (fd >= 0) { ::close(fd); }
+#endif
+  if (!_mapped) {
+    std::ifstream input_file(filename, std::ios::in | std::ios::binary);
+    if (!input_file.is_open()) {
+      throw std::runtime_error("Failed to open trajectory file "+filename);
+    }
+    _buffer.assign(std::istreambuf_iterator<char>(input_file),
+                   std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+  }
+
+  // Check both magic strings and that the index and case table fit
+  TrajectoryFooter footer;
+  const size_t header_end = sizeof(trajectory_magic) + sizeof(_header);
+  if (_size >= header_end + sizeof(footer)) {
+    std::memcpy(&_header, _data + sizeof(trajectory_magic), sizeof(_header));
+    std::memcpy(&footer, _data + _size - sizeof(footer), sizeof(footer));
+  }
+  if (_size < header_end + sizeof(footer) ||
+      std::memcmp(_data, trajectory_magic, sizeof(trajectory_magic)) != 0 ||
+      std::memcmp(footer._magic, trajectory_magic,
+                  sizeof(trajectory_magic)) != 0 ||
+      footer._index_offset < header_end ||
+      footer._index_offset +
+        footer._num_histories*sizeof(TrajectoryIndex) +
+        footer._num_cases*sizeof(TrajectoryCase) + sizeof(footer) != _size) {
+    unmap();
+    throw std::runtime_error(
+      "Not a complete trajectory file: "+filename);
+  }
+  _index = reinterpret_cast<const TrajectoryIndex *>(
+    _data + footer._index_offset);
+  _num_histories = footer._num_histories;
+  _cases.resize(footer._num_cases);
+  std::memcpy(_cases.data(),
+    _data + footer._index_offset +
+      _num_histories*sizeof(TrajectoryIndex),
+    _cases.size()*sizeof(TrajectoryCase));
+  for (uint64_t i = 0; i < _num_histories; i++) {
+    if (_index[i]._offset < header_end ||
+        _index[i]._offset > footer._index_offset ||
+        _index[i]._case >= _cases.size()) {
+      unmap();
+      throw std::runtime_error("Trajectory file index is corrupt");
+    }
+  }
+}
+
+void TrajectoryReader::unmap() {
+#ifdef GRIDWALK_HAS_MMAP
+  if (_mapped) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+    _mapped = false;
+  }
+#endif
+}
+
+} // end namespace util
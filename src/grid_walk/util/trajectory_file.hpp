@@ -0,0 +1,179 @@
+#ifndef __TRAJECTORY_FILE_HEADER__
+#define __TRAJECTORY_FILE_HEADER__
+
+#include "coord.hpp"
+#include "dist.hpp"
+#include "results_writer.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Grid a trajectory file was walked on
+struct TrajectoryHeader {
+  uint64_t _grid_hash = 0;
+  uint64_t _x_dim = 0;
+  uint64_t _y_dim = 0;
+  uint64_t _start_x = 0;
+  uint64_t _start_y = 0;
+  uint64_t _goal_x = 0;
+  uint64_t _goal_y = 0;
+  double _max_steps = 0;
+};
+
+// Location of the moves of one history in a trajectory file
+struct TrajectoryIndex {
+  // Offset of the first move from the start of the file
+  uint64_t _offset = 0;
+  // Number of moves, the number of steps of the history
+  uint32_t _num_moves = 0;
+  // Position of the case of the history in the case table
+  uint32_t _case = 0;
+};
+
+// Case of a walk parameters file whose histories were recorded
+struct TrajectoryCase {
+  // Index of the case in the walk parameters file, 0 is the analog case
+  uint64_t _case_idx = 0;
+  double _params[num_PMF_params] = {};
+  // Index of the first history of the case and the number of histories
+  uint64_t _first_history = 0;
+  uint64_t _num_histories = 0;
+};
+
+// Moves are coded in one byte, the direction in the high 3 bits and the
+// distance in the low 5 bits. Distances of escape_distance or more store
+// escape_distance and are followed by the rest of the distance as a varint
+// of 7 bits per byte, low bits first.
+static const unsigned int escape_distance = 31;
+
+// Records every move of every history into a trajectory file. Moves of a
+// history are buffered and written when it ends, and the index of every
+// history and the case table are written as a footer on close.
+class TrajectoryWriter {
+private:
+  std::ofstream _output_file;
+  // Moves of the current history
+  std::vector<uint8_t> _moves;
+  // Number of moves of the current history
+  uint32_t _num_moves = 0;
+  // Offset the next history is written at
+  uint64_t _offset = 0;
+  std::vector<TrajectoryIndex> _index;
+  std::vector<TrajectoryCase> _cases;
+
+public:
+  TrajectoryWriter(const std::string & filename,
+                   const TrajectoryHeader & header);
+  ~TrajectoryWriter() { close(); }
+
+  bool is_open() const { return _output_file.is_open(); }
+
+  // Histories recorded after this call belong to case case_idx of the walk
+  // parameters file
+  void begin_case(uint64_t case_idx, const std::vector<double> & params);
+
+  // Starts a new history, discarding the moves of an unfinished one
+  void begin_history() {
+    _moves.clear();
+    _num_moves = 0;
+  }
+
+  // Records a move of dist nodes in dir
+  void add_move(direction dir, unsigned int dist) {
+    ++_num_moves;
+    if (dist < escape_distance) {
+      _moves.push_back((dir << 5) | dist);
+      return;
+    }
+    _moves.push_back((dir << 5) | escape_distance);
+    dist -= escape_distance;
+    while (dist >= 0x80) {
+      _moves.push_back((dist & 0x7f) | 0x80);
+      dist >>= 7;
+    }
+    _moves.push_back(dist);
+  }
+
+  // Writes the moves of the current history
+  void end_history();
+
+  // Number of histories recorded so far
+  uint64_t num_histories() const { return _index.size(); }
+
+  // Writes the index and case table and closes the file
+  void close();
+};
+
+// Reads a trajectory file, memory mapped where supported and read whole
+// otherwise, so any history is decoded without reading the others
+class TrajectoryReader {
+private:
+  // Contents of the file
+  const uint8_t * _data = nullptr;
+  size_t _size = 0;
+  // True if _data is a memory mapping
+  bool _mapped = false;
+  // Contents of a file that is not memory mapped
+  std::vector<uint8_t> _buffer;
+  TrajectoryHeader _header;
+  const TrajectoryIndex * _index = nullptr;
+  uint64_t _num_histories = 0;
+  std::vector<TrajectoryCase> _cases;
+
+  // Unmap a memory mapped file
+  void unmap();
+
+public:
+  TrajectoryReader(const std::string & filename);
+  ~TrajectoryReader() { unmap(); }
+  TrajectoryReader(const TrajectoryReader &) = delete;
+  TrajectoryReader & operator=(const TrajectoryReader &) = delete;
+
+  const TrajectoryHeader & header() const { return _header; }
+
+  // True if the file is memory mapped
+  bool is_mapped() const { return _mapped; }
+
+  uint64_t num_histories() const { return _num_histories; }
+
+  const TrajectoryIndex & history(uint64_t i) const { return _index[i]; }
+
+  const std::vector<TrajectoryCase> & cases() const { return _cases; }
+
+  // Calls visit(position, dir, dist) for every move of history i, with
+  // position the node the move ends at, and returns the final node
+  template <typename Visit>
+  Coord replay(uint64_t i, Visit visit) const {
+    const TrajectoryIndex & entry = _index[i];
+    const uint8_t * move = _data + entry._offset;
+    long long x = _header._start_x;
+    long long y = _header._start_y;
+    for (uint32_t m = 0; m < entry._num_moves; m++) {
+      direction dir = static_cast<direction>(*move >> 5);
+      unsigned int dist = *move++ & escape_distance;
+      if (dist == escape_distance) {
+        unsigned int shift = 0;
+        unsigned int rest = 0;
+        do {
+          rest |= static_cast<unsigned int>(*move & 0x7f) << shift;
+          shift += 7;
+        } while (*move++ & 0x80);
+        dist += rest;
+      }
+      x += Lattice<2>::increments[dir][0]*static_cast<long long>(dist);
+      y += Lattice<2>::increments[dir][1]*static_cast<long long>(dist);
+      visit(Coord(x, y), dir, dist);
+    }
+    return Coord(x, y);
+  }
+};
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,37 @@
+#include "walk_moments.hpp"
+
+// Utility namespace
+namespace util {
+
+void WalkMoments::add(uint64_t steps) {
+  ++_histories;
+  _sum_steps += steps;
+  _sum_sq_steps += steps*steps;
+  int bin = 0;
+  for (uint64_t value = steps+1; value > 1; value >>= 1) { ++bin; }
+  ++_step_histogram[bin];
+}
+
+void WalkMoments::merge(const WalkMoments & other) {
+  _histories += other._histories;
+  _sum_steps += other._sum_steps;
+  _sum_sq_steps += other._sum_sq_steps;
+  _aborted = _aborted || other._aborted;
+  for (int i = 0; i < num_step_bins; i++) {
+    _step_histogram[i] += other._step_histogram[i];
+  }
+}
+
+double WalkMoments::mean(double max_steps) const {
+  if (_aborted) { return max_steps; }
+  return _histories > 0 ? static_cast<double>(_sum_steps)/_histories : 0;
+}
+
+double WalkMoments::mean_variance() const {
+  if (_aborted || _histories == 0) { return 0; }
+  double m1 = static_cast<double>(_sum_steps)/_histories;
+  double m2 = static_cast<double>(_sum_sq_steps)/_histories;
+  return (m2 - m1*m1)/_histories;
+}
+
+} // end namespace util
@@ -0,0 +1,44 @@
+#ifndef __WALK_MOMENTS_HEADER__
+#define __WALK_MOMENTS_HEADER__
+
+#include <cstdint>
+
+// Utility namespace
+namespace util {
+
+// Number of log2 bins of the histogram of steps per history
+static const int num_step_bins = 64;
+
+// Integer moments of the number of steps of a set of histories. Moments of
+// disjoint sets of histories merge exactly by addition, so histories may be
+// split across processes and combined in any order.
+struct WalkMoments {
+  // Number of histories walked
+  uint64_t _histories = 0;
+  // Sum of the number of steps of each history
+  uint64_t _sum_steps = 0;
+  // Sum of the squared number of steps of each history
+  uint64_t _sum_sq_steps = 0;
+  // Nonzero if any history exceeded the max number of steps, a full word so
+  // the struct has no padding when written to file
+  uint64_t _aborted = 0;
+  // Histories by bin floor(log2(steps+1)) of their number of steps
+  uint64_t _step_histogram[num_step_bins] = {};
+
+  // Add a single history
+  void add(uint64_t steps);
+
+  // Add the moments of a disjoint set of histories
+  void merge(const WalkMoments & other);
+
+  // Estimate of the mean number of steps, max_steps if any history was
+  // aborted
+  double mean(double max_steps) const;
+
+  // Estimate of the variance of the mean, 0 if any history was aborted
+  double mean_variance() const;
+};
+
+} // end namespace util
+
+#endif
@@ -0,0 +1,57 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+// Utility namespace
+namespace util {
+
+WorkerPool::WorkerPool(unsigned int num_workers) {
+  if (num_workers == 0) {
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned int i = 0; i < num_workers; i++) {
+    _workers.emplace_back(&WorkerPool::run, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _job_ready.notify_all();
+  for (auto & worker : _workers) { worker.join(); }
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push_back(std::move(job));
+    ++_num_pending;
+  }
+  _job_ready.notify_one();
+}
+
+void WorkerPool::wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _jobs_done.wait(lock, [this]() { return _num_pending == 0; });
+}
+
+void WorkerPool::run() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _job_ready.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+      // Queued jobs are finished before stopping
+      if (_jobs.empty()) { return; }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+    job();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (--_num_pending == 0) { _jobs_done.notify_all(); }
+  }
+}
+
+} // end namespace util
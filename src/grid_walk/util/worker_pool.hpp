@@ -0,0 +1,54 @@
+#ifndef __WORKER_POOL_HEADER__
+#define __WORKER_POOL_HEADER__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Utility namespace
+namespace util {
+
+// Fixed set of threads running submitted jobs in submission order
+class WorkerPool {
+private:
+  // Threads running the jobs
+  std::vector<std::thread> _workers;
+  // Jobs waiting for a free worker
+  std::deque<std::function<void()>> _jobs;
+  // Number of jobs submitted and not yet finished
+  unsigned long long _num_pending = 0;
+  // True once the pool is shutting down
+  bool _stopping = false;
+  std::mutex _mutex;
+  // Signals new jobs or shutdown to the workers
+  std::condition_variable _job_ready;
+  // Signals that all pending jobs have finished
+  std::condition_variable _jobs_done;
+
+  // Loop run by each worker
+  void run();
+
+public:
+  // Start num_workers threads, 0 uses all hardware threads
+  WorkerPool(unsigned int num_workers = 0);
+  // Finishes all submitted jobs before joining the workers
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool & operator=(const WorkerPool &) = delete;
+
+  // Number of worker threads
+  unsigned int num_workers() const { return _workers.size(); }
+
+  // Queue a job to run on the next free worker
+  void submit(std::function<void()> job);
+
+  // Block until all submitted jobs have finished
+  void wait();
+};
+
+} // end namespace util
+
+#endif
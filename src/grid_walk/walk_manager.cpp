@@ -1,14 +1,25 @@
 #include "walk_manager.hpp"
 
+#include "util/hash.hpp"
+#include "util/perf_counters.hpp"
 #include "util/rand.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 
+// Analog PMF parameters, equiprobable directions and lambda of 1
+static const std::vector<double> analog_PMF =
+  {0.125,0.125,0.125,0.125,0.125,0.125,0.125,0.125,1.0};
+
 // Reads the simulation specifications,
 // either training data generation or simulated annealing
 //
@@ -16,6 +27,7 @@
 // Entries [number_of_PMF_sets]
 // Samples [number_of_samples_per_walk]
 // Print Spatial Distributions [0/1]
+// [optional keyword lines]
 // [direction pmf values] [distance pmf value]
 //                       .
 //                       .
@@ -27,8 +39,47 @@
 // Optimization [number_of_function_evaluations]
 // Samples [number_of_samples_per_walk]
 // Print Spatial Distributions [0/1]
-WalkManager::WalkManager(std::ifstream & input_file)
-    : _prob_distributions(util::RNG()) {
+// [optional keyword lines]
+//
+// Optional keyword lines:
+// Engine analog
+//   step by step walks, the default
+// Engine block [block_size] [table_samples] [exact_radius]
+//   block decomposition engine, see BlockTables, exact_radius defaults to 1
+// Tally endpoint
+//   spatial distributions count the node each step ends at, the default
+// Tally path
+//   spatial distributions count every node each step traverses
+// Sampling random
+//   independent pseudorandom histories, the default
+// Sampling antithetic
+//   antithetic pairs of histories
+// Sampling sobol [dimensions] [randomizations]
+//   randomized Sobol points drive the first decisions of each history, see
+//   MCWalk::set_sampling
+// Generate lhs [points] [seed]
+// Generate sobol [points] [seed]
+// Generate one_direction [weight]
+//   entries generated after those of the file, see util::ParamDesign, seed
+//   defaults to 16180339 and weight to 63
+// Generate lambdas [lambda] ...
+//   distance PMF parameters paired with every generated direction PMF,
+//   defaults to 1
+// Generate rate [rate]
+//   rate of the truncated exponential marginals of generated direction
+//   weights, defaults to 5
+// Budget [seconds] [steps]
+//   wall clock seconds and total steps of all histories of each case, 0 for
+//   no limit, cases stopped at a limit or with histories reaching the max
+//   number of steps return a censored estimate, see MCWalk::set_budget
+// Reweight [window] [radius] [min_ess]
+//   entries are read window at a time and clusters of entries within radius
+//   of each other estimated from the histories of one reference PMF, entries
+//   with an effective sample size below min_ess times the samples are walked
+//   directly, see run_reweighted_cases, radius defaults to 0.25 and min_ess
+//   to 0.1
+WalkManager::WalkManager(std::istream & input_file)
+    : _prob_distributions(util::RNG()), _input_file(&input_file) {
   // Read in simulation specifications
   std::string run_type;
   std::string junk;
@@ -36,27 +87,24 @@ WalkManager::WalkManager(std::ifstream & input_file)
   input_file >> run_type >> num;
   input_file >> junk >> _num_samples;
   input_file >> junk >> junk >> junk >> _print_grids;
+  read_options();
 
-  // Add analog simulation to list regardless of simulation mode
-  _walk_data.push_back(std::vector<double>(
-    {0.125,0.125,0.125,0.125,0.125,0.125,0.125,0.125,1.0}));
-  
-  // Setup to simulate all passed PMF parameters
+  // Setup to simulate all passed PMF parameters, entries are read as they
+  // are run
   if (run_type == "Entries" || run_type == "entries") {
     _optimize=false;
-    _walk_data.reserve(num+1);
-    for (int i = 0; i < num; i++) {
-      double val;
-      std::vector<double> row_data;
-      for (int j = 0; j < 9; j++) {
-        input_file >> val;
-        row_data.push_back(val);
-      }
-      _walk_data.push_back(row_data);
+    _num_file_entries = num;
+    if (num + _design.size() >
+        static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+      throw std::runtime_error("Too many entries to generate");
     }
+    _num_entries = num + _design.size();
   }
   // Setup to perform optimization
   else if (run_type == "Optimization" | run_type == "optimization") {
+    if (!_design.empty()) {
+      throw std::runtime_error("Generated entries need an Entries run");
+    }
     _optimize=true;
     _num_evals=num;
   }
@@ -64,70 +112,500 @@ WalkManager::WalkManager(std::ifstream & input_file)
     throw std::runtime_error(
       "Input file parameter "+run_type+" not recognized");
   }
+  if (_budgeted && _block_size > 0) {
+    throw std::runtime_error("Budgeted walks need the analog engine");
+  }
+  if (_reweight_window > 0) {
+    if (_optimize || _print_grids) {
+      throw std::runtime_error(
+        "Reweighted walks need an Entries run without spatial distributions");
+    }
+    if (_block_size > 0 || _budgeted ||
+        _sampling != util::sampling::random_sampling) {
+      throw std::runtime_error(
+        "Reweighted walks need the analog engine, pseudorandom sampling, and "
+        "no budget");
+    }
+  }
+}
+
+// Keyword lines start with a letter, PMF entries with a number
+void WalkManager::read_options() {
+  std::string line;
+  while (*_input_file >> std::ws &&
+         std::isalpha(_input_file->peek()) &&
+         std::getline(*_input_file, line)) {
+    parse_option(line);
+  }
+}
+
+void WalkManager::parse_option(const std::string & line) {
+  std::stringstream option(line);
+  std::string keyword, value;
+  option >> keyword >> value;
+
+  if (keyword == "Engine" || keyword == "engine") {
+    if (value == "analog") {
+      _block_size = 0;
+    }
+    else if (value == "block") {
+      if (!(option >> _block_size >> _table_samples) ||
+          _block_size == 0 || _table_samples == 0) {
+        throw std::runtime_error(
+          "Engine block requires a block size and table samples");
+      }
+      if (!(option >> _exact_radius)) { _exact_radius = 1; }
+    }
+    else {
+      throw std::runtime_error("Engine "+value+" not recognized");
+    }
+  }
+  else if (keyword == "Sampling" || keyword == "sampling") {
+    if (value == "random") {
+      _sampling = util::sampling::random_sampling;
+    }
+    else if (value == "antithetic") {
+      _sampling = util::sampling::antithetic_sampling;
+    }
+    else if (value == "sobol") {
+      if (!(option >> _sobol_dimensions >> _randomizations)) {
+        throw std::runtime_error(
+          "Sampling sobol requires dimensions and randomizations");
+      }
+      _sampling = util::sampling::sobol_sampling;
+      // Check the settings while the input is being read
+      MCWalk(nullptr).set_sampling(
+        _sampling, _sobol_dimensions, _randomizations);
+    }
+    else {
+      throw std::runtime_error("Sampling "+value+" not recognized");
+    }
+  }
+  else if (keyword == "Generate" || keyword == "generate") {
+    if (value == "lambdas") {
+      std::vector<double> lambdas;
+      double lambda;
+      while (option >> lambda) { lambdas.push_back(lambda); }
+      _design.set_lambdas(lambdas);
+    }
+    else if (value == "rate") {
+      double rate;
+      if (!(option >> rate)) {
+        throw std::runtime_error("Generate rate requires a rate");
+      }
+      _design.set_marginal_rate(rate);
+    }
+    else {
+      util::DesignSpec spec;
+      spec._type = util::to_design_type(value);
+      if (spec._type == util::design_type::one_direction) {
+        if (!(option >> spec._weight)) { spec._weight = 63; }
+      }
+      else {
+        if (!(option >> spec._num_points)) {
+          throw std::runtime_error(
+            "Generate "+value+" requires the number of points");
+        }
+        if (!(option >> spec._seed)) { spec._seed = 16180339; }
+      }
+      _design.add(spec);
+    }
+  }
+  else if (keyword == "Budget" || keyword == "budget") {
+    std::stringstream seconds(value);
+    double steps = 0;
+    if (!(seconds >> _budget._seconds)) {
+      throw std::runtime_error("Budget requires a number of seconds");
+    }
+    if (!(option >> steps)) { steps = 0; }
+    if (!(_budget._seconds >= 0) || !(steps >= 0)) {
+      throw std::runtime_error("Budget limits must not be negative");
+    }
+    _budget._steps = steps;
+    _budgeted = true;
+  }
+  else if (keyword == "Reweight" || keyword == "reweight") {
+    std::stringstream window(value);
+    if (!(window >> _reweight_window) || _reweight_window == 0) {
+      throw std::runtime_error("Reweight requires a window of entries");
+    }
+    if (!(option >> _reweight_radius)) { _reweight_radius = 0.25; }
+    if (!(option >> _min_ess)) { _min_ess = 0.1; }
+    if (!(_reweight_radius >= 0) || !(_min_ess >= 0)) {
+      throw std::runtime_error("Reweight limits must not be negative");
+    }
+  }
+  else if (keyword == "Tally" || keyword == "tally") {
+    if (value == "endpoint") { _path_tally = false; }
+    else if (value == "path") { _path_tally = true; }
+    else { throw std::runtime_error("Tally "+value+" not recognized"); }
+  }
+  else {
+    throw std::runtime_error(
+      "Input file parameter "+keyword+" not recognized");
+  }
+}
+
+// Settings are hashed by value, so equivalent option lines share cached
+// results, and settings left at their defaults hash to 0. Tally, Generate,
+// and Reweight lines do not change the result of a walked case and leave
+// the hash unchanged.
+uint64_t WalkManager::options_hash() const {
+  const bool sobol = _sampling == util::sampling::sobol_sampling;
+  const double settings[] = {
+    static_cast<double>(_block_size),
+    _block_size > 0 ? static_cast<double>(_table_samples) : 0.0,
+    _block_size > 0 ? static_cast<double>(_exact_radius) : 0.0,
+    static_cast<double>(_sampling),
+    sobol ? static_cast<double>(_sobol_dimensions) : 0.0,
+    sobol ? static_cast<double>(_randomizations) : 0.0,
+    _budgeted ? 1.0 : 0.0,
+    _budgeted ? _budget._seconds : 0.0,
+    _budgeted ? static_cast<double>(_budget._steps) : 0.0};
+  for (double setting : settings) {
+    if (setting != 0) { return util::fnv1a(settings, sizeof(settings)); }
+  }
+  return 0;
+}
+
+void WalkManager::configure_walk(MCWalk & walk) const {
+  walk.set_path_tally(_path_tally);
+  walk.set_sampling(_sampling, _sobol_dimensions, _randomizations);
+  if (_budgeted) { walk.set_budget(_budget); }
+  if (_block_size > 0) {
+    walk.set_block_engine(_block_size, _table_samples, _exact_radius);
+  }
+}
+
+// Reads the 9 PMF parameters of the next entry
+bool WalkManager::read_entry(double * params) {
+  if (_num_read++ >= _num_file_entries) { return _design.next(params); }
+  for (int j = 0; j < util::num_PMF_params; j++) {
+    if (!(*_input_file >> params[j])) { return false; }
+  }
+  return true;
+}
+
+util::CacheRecord WalkManager::cache_key(
+    const MCWalk & walk, const std::vector<double> & params) const {
+  util::CacheRecord key;
+  key._grid_hash = _grid_hash;
+  key._samples = _num_samples;
+  key._seed = walk.get_seed();
+  key._options_hash = options_hash();
+  std::copy(params.begin(), params.end(), key._params);
+  return key;
 }
 
 // Perform walk for the passed mc_walk object with timing and printing
-// return the mean number of steps 
-double WalkManager::time_walk(MCWalk & walk, int i) const {
-  std::cout << "Starting walk " << i << std::endl;
-  auto start = std::chrono::steady_clock::now();
-  double mean = walk.walk_grid(_num_samples);
-  auto end = std::chrono::steady_clock::now();
-  std::cout << "Random walk complete" << std::endl;
-  std::cout << "Clock time: "
-            << std::chrono::duration_cast<std::chrono::seconds>(
-              end - start).count() << " sec" << std::endl;
+// return the results of the walk
+util::CaseResult WalkManager::time_walk(
+    MCWalk & walk, int i, const std::vector<double> & params) const {
+  std::cout << "Starting walk " << i << "\n";
+  // Tracked and recorded walks are always run so their spatial distributions
+  // and trajectories are kept
+  util::CacheRecord cached;
+  bool use_cache = _result_cache != nullptr && !walk.tracks_grid() &&
+    _trajectories == nullptr;
+  if (_trajectories != nullptr) {
+    _trajectories->begin_case(i, params);
+  }
+  walk.set_recorder(_trajectories);
+  if (use_cache) { cached = cache_key(walk, params); }
+  util::perf_counters().clear();
+  double runtime;
+  double samples = _num_samples;
+  if (use_cache && _result_cache->find(cached)) {
+    walk.set_results(cached._mean, cached._error, cached._FOM);
+    runtime = cached._runtime;
+    std::cout << "Random walk found in result cache\n";
+  }
+  else {
+    auto start = std::chrono::steady_clock::now();
+    walk.walk_grid(_num_samples);
+    auto end = std::chrono::steady_clock::now();
+    runtime = std::chrono::duration<double>(end - start).count();
+    std::cout << "Random walk complete\n";
+    // Partial and censored results depend on more than the cache key
+    if (walk.is_budgeted()) {
+      samples = walk.get_num_histories();
+      use_cache = use_cache && !walk.cut_short() &&
+        walk.get_num_censored() == 0;
+    }
+    if (use_cache) {
+      cached._mean = walk.get_mean();
+      cached._error = walk.get_error();
+      cached._FOM = walk.get_FOM();
+      cached._runtime = runtime;
+      _result_cache->insert(cached);
+    }
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Clock time: " << runtime << " sec\n";
   walk.print_results();
-  return mean;
+  std::cout.flush();
+
+  util::CaseResult result;
+  std::copy(params.begin(), params.end(), result._params);
+  result._mean = walk.get_mean();
+  result._error = walk.get_error();
+  result._samples = samples;
+  result._runtime = runtime;
+  if (_perf_output != nullptr) {
+    util::perf_counters().write_json(
+      *_perf_output, i, samples, result._mean, runtime);
+    _perf_output->flush();
+  }
+  return result;
+}
+
+// The figure of merit per second of runtime compares modes by the error
+// reached per CPU second rather than per step
+void WalkManager::compare_sampling(
+    Grid * grid, const MCWalk & walk, const util::CaseResult & result) const {
+  if (_sampling == util::sampling::random_sampling) { return; }
+  MCWalk reference_walk(grid);
+  reference_walk.set_verbose(false);
+  auto start = std::chrono::steady_clock::now();
+  reference_walk.walk_grid(_num_samples);
+  double runtime = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  auto time_FOM = [](double error, double runtime) {
+    return (error > 0 && runtime > 0) ? 1.0/(error*error*runtime) : 0.0;
+  };
+  std::cout << std::fixed << std::setprecision(5);
+  std::cout << "Sampling       error        FOM   FOM/sec\n";
+  std::cout << "random   " << std::setw(10) << reference_walk.get_error();
+  std::cout << " " << std::setw(10) << reference_walk.get_FOM() << " ";
+  std::cout << std::setw(9) << time_FOM(reference_walk.get_error(), runtime);
+  std::cout << "\n";
+  std::cout << (_sampling == util::sampling::antithetic_sampling ?
+                "antithetic" : "sobol     ");
+  std::cout << std::setw(9) << result._error;
+  std::cout << " " << std::setw(10) << walk.get_FOM() << " ";
+  std::cout << std::setw(9) << time_FOM(result._error, result._runtime);
+  std::cout << std::endl;
+}
+
+// Sum the visits of the last walk and append them to the spatial
+// distribution file
+void WalkManager::write_visits(
+    const Grid * grid, bool tracked, double num_histories) {
+  if (!tracked || _visit_writer == nullptr) { return; }
+  grid->get_visit_map(_visit_map, num_histories, _downsample);
+  _visit_writer->write(_visit_map);
 }
 
 // Simulate all passed PMF parameters
-void WalkManager::run_all_cases(Grid * grid) {
-  std::cout << "Running " << _walk_data.size() << " random walks with ";
+void WalkManager::run_all_cases(Grid * grid, util::ResultsSink & results) {
+  std::cout << "Running " << _num_entries+1 << " random walks with ";
   std::cout << _num_samples << " samples each" << std::endl;
   std::cout << "Walk 0 is analog walk\n" << std::endl;
 
   // Run the analog case first and save the grid
   MCWalk analog_walk(grid, _print_grids);
-  double analog_FOM = time_walk(analog_walk, 0);
-  _walk_data[0].push_back(analog_FOM);
-  if (_print_grids) { grid->print(std::cout, _num_samples); }
+  configure_walk(analog_walk);
+  util::CaseResult analog_result = time_walk(analog_walk, 0, analog_PMF);
+  results.write(analog_result);
+  write_visits(grid, _print_grids, analog_result._samples);
+  compare_sampling(grid, analog_walk, analog_result);
 
-  // Run all the biased cases
+  // Run all the biased cases, reading each entry just before it is run
   MCWalk grid_walk(grid, _print_grids);
-  for (size_t i = 1; i < _walk_data.size(); i++) {
+  configure_walk(grid_walk);
+  if (_reweight_window > 0) {
+    run_reweighted_cases(grid, grid_walk, results);
+    return;
+  }
+  std::vector<double> params(util::num_PMF_params);
+  for (int i = 1; i <= _num_entries; i++) {
+    if (!read_entry(params.data())) {
+      throw std::runtime_error(
+        "Failed to read PMF entry "+std::to_string(i)+" of "+
+        std::to_string(_num_entries));
+    }
     grid_walk.reset();
-    grid_walk.set_biased_PMF(_walk_data[i]);
+    grid_walk.set_biased_PMF(params);
     grid->clear_visits();
-    _walk_data[i].push_back(time_walk(grid_walk, i));
-    if (_print_grids) { grid->print(std::cout, _num_samples); }
+    util::CaseResult result = time_walk(grid_walk, i, params);
+    results.write(result);
+    write_visits(grid, _print_grids, result._samples);
   }
   // Clear visits before returning
   grid->clear_visits();
 }
 
+// Distance between two PMFs, the L1 distance of their normalized direction
+// PMFs plus the distance of their log lambdas
+static double PMF_distance(const double * a, const double * b) {
+  const int lambda = util::num_PMF_params-1;
+  const double total_a = std::accumulate(a, a+lambda, 0.0);
+  const double total_b = std::accumulate(b, b+lambda, 0.0);
+  double distance = std::abs(std::log(a[lambda]) - std::log(b[lambda]));
+  for (int d = 0; d < lambda; d++) {
+    distance += std::abs(a[d]/total_a - b[d]/total_b);
+  }
+  return distance;
+}
+
+// Entries are read a window at a time. The first entry of the window not yet
+// clustered and every later entry within the radius of it form a cluster,
+// walked once with the mean of their normalized PMFs as the reference, which
+// takes every decision any entry of the cluster takes. Entries whose effective
+// sample size falls below the minimum, clusters of one entry, and entries
+// already in the result cache are walked directly. Reweighted entries report
+// their effective sample size as their samples and an equal share of the
+// runtime of the reference, and results are written in entry order once the
+// window is done.
+void WalkManager::run_reweighted_cases(
+    Grid * grid, MCWalk & grid_walk, util::ResultsSink & results) {
+  if (_trajectories != nullptr) {
+    throw std::runtime_error("Reweighted walks cannot be recorded");
+  }
+  const unsigned int max_dist =
+    std::max(grid->get_x_dim(), grid->get_y_dim());
+  const double min_samples = _min_ess*_num_samples;
+  // Entries are read into the parameters of their results
+  std::vector<util::CaseResult> window(_reweight_window);
+  std::vector<bool> clustered, reweighted;
+  std::vector<int> cluster;
+  std::vector<double> reference;
+  std::vector<double> params(util::num_PMF_params);
+  unsigned long long num_reweighted = 0, num_references = 0;
+  for (int first = 1; first <= _num_entries; first += _reweight_window) {
+    const int count = std::min<int>(_reweight_window, _num_entries-first+1);
+    for (int n = 0; n < count; n++) {
+      if (!read_entry(window[n]._params)) {
+        throw std::runtime_error(
+          "Failed to read PMF entry "+std::to_string(first+n)+" of "+
+          std::to_string(_num_entries));
+      }
+    }
+    // Cached entries are left out of the clusters and read back by time_walk
+    clustered.assign(count, false);
+    if (_result_cache != nullptr) {
+      for (int n = 0; n < count; n++) {
+        params.assign(window[n]._params, window[n]._params+params.size());
+        util::CacheRecord key = cache_key(grid_walk, params);
+        clustered[n] = _result_cache->find(key);
+      }
+    }
+    reweighted.assign(count, false);
+    for (int seed = 0; seed < count; seed++) {
+      if (clustered[seed]) { continue; }
+      cluster.clear();
+      for (int n = seed; n < count; n++) {
+        if (!clustered[n] &&
+            PMF_distance(window[seed]._params, window[n]._params) <=
+              _reweight_radius) {
+          cluster.push_back(n);
+          clustered[n] = true;
+        }
+      }
+      if (cluster.size() < 2) { continue; }
+
+      reference.assign(util::num_PMF_params, 0.0);
+      for (int n : cluster) {
+        const double * entry = window[n]._params;
+        const int lambda = util::num_PMF_params-1;
+        double total = std::accumulate(entry, entry+lambda, 0.0);
+        for (int d = 0; d < lambda; d++) {
+          reference[d] += entry[d]/total/cluster.size();
+        }
+        reference.back() += entry[lambda]/cluster.size();
+      }
+      util::LikelihoodRatios ratios(reference, max_dist);
+      for (int n : cluster) {
+        params.assign(window[n]._params, window[n]._params+params.size());
+        ratios.add_target(params);
+      }
+      std::cout << "Reweighting " << cluster.size() << " walks from walk ";
+      std::cout << first+seed << "\n";
+      grid_walk.reset();
+      grid_walk.set_biased_PMF(reference);
+      auto start = std::chrono::steady_clock::now();
+      bool complete = grid_walk.walk_reweighted(_num_samples, ratios);
+      double runtime = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+      ++num_references;
+      if (!complete) { continue; }
+
+      for (size_t c = 0; c < cluster.size(); c++) {
+        double samples = ratios.effective_samples(c);
+        if (!ratios.supported(c) || samples < min_samples) { continue; }
+        util::CaseResult & result = window[cluster[c]];
+        result._mean = ratios.mean(c);
+        result._error = ratios.error(c);
+        result._samples = samples;
+        result._runtime = runtime / cluster.size();
+        reweighted[cluster[c]] = true;
+      }
+    }
+
+    for (int n = 0; n < count; n++) {
+      if (reweighted[n]) {
+        const util::CaseResult & result = window[n];
+        std::cout << "Starting walk " << first+n << "\n";
+        std::cout << "Random walk reweighted, effective samples ";
+        std::cout << std::fixed << std::setprecision(1) << result._samples;
+        std::cout << "\n" << std::setprecision(5);
+        std::cout << "mean:  " << std::setw(8) << result._mean << "\n";
+        std::cout << "error: " << std::setw(8) << result._error << "\n";
+        ++num_reweighted;
+      }
+      else {
+        params.assign(window[n]._params, window[n]._params+params.size());
+        grid_walk.reset();
+        grid_walk.set_biased_PMF(params);
+        window[n] = time_walk(grid_walk, first+n, params);
+      }
+      results.write(window[n]);
+    }
+    std::cout.flush();
+  }
+  std::cout << "Reweighted " << num_reweighted << " of " << _num_entries;
+  std::cout << " walks from " << num_references << " reference walks";
+  std::cout << std::endl;
+}
+
+// Most accepted candidates reserved before annealing, more grow the table
+static const size_t max_reserved_cases = 1024;
+
 // Perform simulated annealing starting with analog case
-void WalkManager::simulate_annealing(Grid * grid) {
+void WalkManager::simulate_annealing(
+    Grid * grid, util::ResultsSink & results) {
   std::cout << "Running " << _num_evals << " random walks with ";
   std::cout << _num_samples << " samples each" << std::endl;
   std::cout << "Walk 0 is analog walk\n" << std::endl;
 
   // Run the analog case first and save the grid
   MCWalk analog_walk(grid, _print_grids);
-  double analog_mean = time_walk(analog_walk, 0);
-  _walk_data[0].push_back(analog_mean);
-  if (_print_grids) { grid->print(std::cout, _num_samples); }
+  configure_walk(analog_walk);
+  util::CaseResult analog_result = time_walk(analog_walk, 0, analog_PMF);
+  results.write(analog_result);
+  _accepted.clear();
+  _accepted.reserve(std::min(
+    static_cast<size_t>(std::max(1.0, _num_evals)), max_reserved_cases));
+  _accepted.append(analog_result);
+  write_visits(grid, _print_grids, analog_result._samples);
+  compare_sampling(grid, analog_walk, analog_result);
 
   // Save the index of the currently most optimal parameters and value
-  int _min_idx = 0;
+  size_t min_idx = 0;
+  // Candidates are proposed into buffers sized once
+  std::vector<double> current(util::num_PMF_params);
+  std::vector<double> candidate(util::num_PMF_params);
   // Simulate annealing
   MCWalk grid_walk(grid, _print_grids);
+  configure_walk(grid_walk);
   for (int i = 1; i < _num_evals; i++) {
     // Logarithmic cooling T_0 = 0.1
     double temp = -0.1*std::log(i/_num_evals);
-    std::vector<double> candidate = _prob_distributions.sample(
-      std::vector<double>(_walk_data.back().begin(), _walk_data.back().end()-1),
-      temp, 10.0*temp, util::dist_type::guassian);
+    const size_t last_idx = _accepted.size()-1;
+    _accepted.get_params(last_idx, current.data());
+    _prob_distributions.sample(
+      current.data(), current.size(), temp, 10.0*temp, candidate.data(),
+      util::dist_type::guassian);
     // Don't allow negative probabilities
     for (int i = 0; i < 8; i++) { if (candidate[i] < 0) { candidate[i] = 0; } }
 
@@ -135,65 +613,147 @@ void WalkManager::simulate_annealing(Grid * grid) {
     grid_walk.reset();
     grid_walk.set_biased_PMF(candidate);
     grid->clear_visits();
-    candidate.push_back(time_walk(grid_walk, i));
-    if (_print_grids) { grid->print(std::cout, _num_samples); }
+    util::CaseResult result = time_walk(grid_walk, i, candidate);
+    results.write(result);
+    write_visits(grid, _print_grids, result._samples);
 
     // Accept or reject candidate
     if (_prob_distributions.sample(util::dist_type::uniform) <=
         std::min(
-          1.0, std::exp(-(candidate.back()-_walk_data.back().back())/temp))) {
-      _walk_data.push_back(candidate);
+          1.0, std::exp(-(result._mean-_accepted.mean(last_idx))/temp))) {
+      size_t idx = _accepted.append(result);
       // Save new global min if found
-      if (candidate.back() < _walk_data[_min_idx].back()) {
-        _min_idx = _walk_data.size()-1;
-      }
+      if (result._mean < _accepted.mean(min_idx)) { min_idx = idx; }
     }
   }
 
   std::cout << "\n\nOptimization Complete!" << std::endl;
   std::cout << "Analog Case" << std::endl;
   MCWalk final_walk(grid, true);
+  final_walk.set_path_tally(_path_tally);
   final_walk.print_walker();
   grid->clear_visits();
-  analog_mean = time_walk(final_walk, _num_evals+1);
-  grid->print(std::cout, _num_samples);
+  time_walk(final_walk, _num_evals+1, analog_PMF);
+  write_visits(grid, true, _num_samples);
   std::cout << "Optimized Case" << std::endl;
   grid->clear_visits();
-  final_walk.set_biased_PMF(std::vector<double>(
-    _walk_data[_min_idx].begin(), _walk_data[_min_idx].end()-1));
+  _accepted.get_params(min_idx, candidate.data());
+  final_walk.set_biased_PMF(candidate);
   final_walk.print_walker();
-  double opt_mean = time_walk(final_walk, _num_evals+2);
-  grid->print(std::cout, _num_samples);
+  time_walk(final_walk, _num_evals+2, candidate);
+  write_visits(grid, true, _num_samples);
 
   // Clear visits before returning
   grid->clear_visits();
 }
 
-void WalkManager::execute(Grid * grid) {
+util::TrajectoryHeader WalkManager::trajectory_header(
+    const Grid * grid) const {
+  util::TrajectoryHeader header;
+  header._grid_hash = grid->hash();
+  header._x_dim = grid->get_x_dim();
+  header._y_dim = grid->get_y_dim();
+  header._start_x = grid->get_start()._x_coord;
+  header._start_y = grid->get_start()._y_coord;
+  header._goal_x = grid->get_goal()._x_coord;
+  header._goal_y = grid->get_goal()._y_coord;
+  header._max_steps = MCWalk::max_walk_steps;
+  return header;
+}
+
+util::ShardHeader WalkManager::shard_header(
+    const Grid * grid, unsigned int shard, unsigned int num_shards,
+    util::shard_mode mode) const {
+  util::ShardHeader header;
+  header._shard = shard;
+  header._num_shards = num_shards;
+  header._mode = mode;
+  header._num_cases = _num_entries+1;
+  header._num_records = (mode == util::shard_mode::shard_histories) ?
+    header._num_cases :
+    (header._num_cases + num_shards - 1 - shard) / num_shards;
+  header._engine_version = util::engine_version;
+  header._grid_hash = grid->hash();
+  header._options_hash = options_hash();
+  header._x_dim = grid->get_x_dim();
+  header._y_dim = grid->get_y_dim();
+  header._num_samples = _num_samples;
+  header._seed = Walker::default_seed;
+  header._max_steps = MCWalk::max_walk_steps;
+  return header;
+}
+
+// Walk the cases of one shard, either every case with the shard's chunks of
+// histories or the shard's cases with all histories
+void WalkManager::execute_shard(
+    Grid * grid, util::ShardWriter & writer,
+    const util::ShardHeader & header) {
   if (_optimize) {
-    simulate_annealing(grid);
+    throw std::runtime_error("Simulated annealing cannot be sharded");
   }
-  else {
-    run_all_cases(grid);
+  if (_block_size > 0) {
+    throw std::runtime_error("The block engine cannot be sharded");
   }
-}
+  if (_sampling != util::sampling::random_sampling) {
+    throw std::runtime_error("Only pseudorandom sampling can be sharded");
+  }
+  if (_budgeted) {
+    throw std::runtime_error("Budgeted walks cannot be sharded");
+  }
+  if (_reweight_window > 0) {
+    throw std::runtime_error("Reweighted walks cannot be sharded");
+  }
+  const bool split_histories =
+    header._mode == util::shard_mode::shard_histories;
+  std::cout << "Running shard " << header._shard << " of ";
+  std::cout << header._num_shards << " of " << _num_entries+1;
+  std::cout << " random walks with " << _num_samples << " samples each";
+  std::cout << std::endl;
 
-void WalkManager::print_results(std::ofstream & output_file) const {
-  output_file << "Entries: " << _walk_data.size() << std::endl;
-  output_file << std::fixed;
-	output_file << std::showpoint;
-	output_file << std::setprecision(5);
-  for (const auto& row : _walk_data) {
-    // Total the direction PMF parameters to normalize
-    double total = std::accumulate(
-      row.begin(), row.end()-2, 0.0, std::plus<double>());
-    for (int i = 0; i < 8; i++) {
-      output_file << std::setw(7) << row[i]/total << " ";
+  MCWalk grid_walk(grid, _print_grids);
+  configure_walk(grid_walk);
+  std::vector<double> params = analog_PMF;
+  for (int i = 0; i <= _num_entries; i++) {
+    // Every entry is read so the input stays in step across shards
+    if (i > 0 && !read_entry(params.data())) {
+      throw std::runtime_error(
+        "Failed to read PMF entry "+std::to_string(i)+" of "+
+        std::to_string(_num_entries));
+    }
+    if (!split_histories && i % header._num_shards != header._shard) {
+      continue;
     }
-    output_file << std::setw(7) << row[8] << " ";
-    output_file << std::setw(7) << row[9] << std::endl;
+    std::cout << "Starting walk " << i << "\n";
+    grid_walk.reset();
+    grid_walk.set_biased_PMF(params);
+    grid->clear_visits();
+
+    util::ShardRecord record;
+    record._case_idx = i;
+    std::copy(params.begin(), params.end(), record._params);
+    auto start = std::chrono::steady_clock::now();
+    record._moments = split_histories ?
+      grid_walk.walk_shard(_num_samples, header._shard, header._num_shards) :
+      grid_walk.walk_shard(_num_samples, 0, 1);
+    record._runtime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    if (_print_grids) { grid->add_visits(record._visits); }
+    writer.write(record);
+
+    std::cout << "Shard walk complete, " << record._moments._histories;
+    std::cout << " histories\n";
+    grid_walk.print_results();
+    std::cout.flush();
+  }
+  grid->clear_visits();
+}
+
+void WalkManager::execute(Grid * grid, util::ResultsSink & results) {
+  if (_result_cache != nullptr) { _grid_hash = grid->hash(); }
+  if (_optimize) {
+    simulate_annealing(grid, results);
   }
-  output_file << "All Monte Carlo walks ran with " << _num_samples;
-  output_file << " samples" << std::endl;
-  output_file << "Maximum steps allowed per walk was 100,000" << std::endl;
-}
\ No newline at end of file
+  else {
+    run_all_cases(grid, results);
+  }
+}
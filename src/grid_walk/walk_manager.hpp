@@ -1,10 +1,21 @@
 #ifndef _WALK_MANAGER_HEADER_
 #define _WALK_MANAGER_HEADER_
 
+#include "util/case_table.hpp"
 #include "util/dist.hpp"
 #include "util/grid.hpp"
+#include "util/npy_writer.hpp"
+#include "util/param_design.hpp"
+#include "util/result_cache.hpp"
+#include "util/results_writer.hpp"
+#include "util/shard_file.hpp"
+#include "util/trajectory_file.hpp"
 #include "mc_walk.hpp"
 
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
 #include <vector>
 
 // Class to perform repeated Monte Carlo simulations to produce training data
@@ -12,12 +23,22 @@ class WalkManager {
 private:
   // Probability distributions class
   util::PDF _prob_distributions;
-  // Vector of parameters and results from each walk performed stored as:
-  // [biased_direction_pmf, biased_distance_pmf, FOM]
-  // Where direction information is stored in the order:
-  // north, north_east, east, south_east,
-  // south, south_west, west, north_west
-  std::vector<std::vector<double>> _walk_data;
+  // Input file holding the biased PMF entries, entries are read one at a
+  // time as cases are run so memory does not grow with the number of entries
+  std::istream * _input_file;
+  // Number of biased PMF entries to simulate, those of the input file
+  // followed by those of the design
+  int _num_entries = 0;
+  // Number of biased PMF entries of the input file
+  int _num_file_entries = 0;
+  // Number of biased PMF entries read so far
+  int _num_read = 0;
+  // Generated biased PMF entries following those of the input file
+  util::ParamDesign _design;
+  // Parameters and results of each accepted simulated annealing candidate,
+  // a modest number reserved up front and grown by doubling as candidates
+  // are accepted
+  util::CaseTable _accepted;
   // Number of times to sample each random walk
   double _num_samples;
   // Number of times to evaluate the function if performing simulated annealing
@@ -26,27 +47,142 @@ private:
   bool _optimize;
   // Boolean whether or not to print the spatial distributions of each walk
   bool _print_grids;
+  // Writer of the spatial distributions, not owned
+  util::NpyWriter * _visit_writer = nullptr;
+  // Number of nodes per side of each block summed in the spatial
+  // distributions
+  unsigned int _downsample = 1;
+  // Buffer holding the spatial distribution of the current walk
+  std::vector<float> _visit_map;
+  // Stream receiving the performance counters of each walk, not owned
+  std::ostream * _perf_output = nullptr;
+  // Persistent cache of case results, not owned
+  util::ResultCache * _result_cache = nullptr;
+  // Recorder of every move of every walk, not owned
+  util::TrajectoryWriter * _trajectories = nullptr;
+  // Hash of the grid being walked, part of the cache key of each case
+  uint64_t _grid_hash = 0;
+  // Block engine settings, a block size of 0 selects the analog engine
+  unsigned int _block_size = 0;
+  unsigned int _table_samples = 0;
+  unsigned int _exact_radius = 1;
+  // Whether tracked walks tally every node traversed by each step
+  bool _path_tally = false;
+  // Sampling mode of every walk, see MCWalk::set_sampling
+  util::sampling _sampling = util::sampling::random_sampling;
+  unsigned int _sobol_dimensions = 0;
+  unsigned int _randomizations = 0;
+  // Per case budget, see MCWalk::set_budget
+  bool _budgeted = false;
+  WalkBudget _budget;
+  // Reweighting settings, a window of 0 walks every case directly, see
+  // run_reweighted_cases
+  unsigned int _reweight_window = 0;
+  double _reweight_radius = 0.25;
+  double _min_ess = 0.1;
 
-  // Helper function to run walk and time the execuation time
-  double time_walk(MCWalk & walk, int i) const;
+  // Reads the optional keyword lines following the header
+  void read_options();
+
+  // Applies a single optional keyword line
+  void parse_option(const std::string & line);
+
+  // Hash of the settings that change the results of a case, part of the
+  // cache key of each case and of the shard headers
+  uint64_t options_hash() const;
+
+  // Key of the result cache of the case of walk with the PMF params
+  util::CacheRecord cache_key(
+    const MCWalk & walk, const std::vector<double> & params) const;
+
+  // Applies the engine settings to a walk
+  void configure_walk(MCWalk & walk) const;
+
+  // Walks the analog case again with pseudorandom sampling and prints the
+  // figures of merit of both sampling modes, if another mode is selected
+  void compare_sampling(
+    Grid * grid, const MCWalk & walk, const util::CaseResult & result) const;
+
+  // Helper function to run walk and time the execuation time, returns the
+  // results of the walk for the passed PMF parameters. Untracked walks
+  // already in the result cache are not run again.
+  util::CaseResult time_walk(
+    MCWalk & walk, int i, const std::vector<double> & params) const;
+
+  // Writes the spatial distribution of the grid if the walk was tracked,
+  // averaged over the num_histories histories walked
+  void write_visits(const Grid * grid, bool tracked, double num_histories);
+
+  // Reads the next biased PMF entry from the input file, or generates it
+  // once the entries of the file are read, into the num_PMF_params values of
+  // params, returns false if no entry could be read
+  bool read_entry(double * params);
 
   // Performs a Monte Carlo walk for the analog PMFs and all biased PMFs in
-  // input file, save the results in _walk_data, and returns a cleared grid
-  void run_all_cases(Grid * grid);
+  // input file, streams the results to file, and returns a cleared grid
+  void run_all_cases(Grid * grid, util::ResultsSink & results);
+
+  // Walks the biased cases a window of entries at a time, estimating each
+  // cluster of neighbouring entries of a window from the histories of one
+  // reference PMF, see MCWalk::walk_reweighted, and walking directly the
+  // entries whose weights degenerate
+  void run_reweighted_cases(
+    Grid * grid, MCWalk & grid_walk, util::ResultsSink & results);
 
   // Performs simulated annealing to determing optimal PMF parameters resulting
-  // in the shortest walk from the start to the goal.
-  void simulate_annealing(Grid * grid);
+  // in the shortest walk from the start to the goal. Every evaluated
+  // candidate is streamed to file.
+  void simulate_annealing(Grid * grid, util::ResultsSink & results);
 
 public:
-  WalkManager(std::ifstream & input_file);
+  // The input file must remain open until execute returns
+  WalkManager(std::istream & input_file);
   ~WalkManager() {};
 
-  // Calls either run_all_cases or simulate_annealing depending on user input
-  void execute(Grid * grid);
+  // True if spatial distributions will be written, either for each walk or
+  // for the final analog and optimized walks of simulated annealing
+  bool writes_visits() const { return _print_grids || _optimize; }
+
+  // Set the writer of the spatial distributions, which must have been sized
+  // for the grid downsampled by the passed factor
+  void set_visit_writer(util::NpyWriter * writer, unsigned int downsample) {
+    _visit_writer = writer;
+    _downsample = downsample;
+  }
+
+  // Set the stream receiving one JSON line of performance counters per walk
+  void set_perf_output(std::ostream * perf_output) {
+    _perf_output = perf_output;
+  }
+
+  // Set the cache checked before each untracked walk and updated after
+  void set_result_cache(util::ResultCache * result_cache) {
+    _result_cache = result_cache;
+  }
+
+  // Set the recorder of every move of every walk, recorded walks are always
+  // run rather than read from the result cache
+  void set_trajectory_writer(util::TrajectoryWriter * trajectories) {
+    _trajectories = trajectories;
+  }
 
-  // Print biased PMF parameters and resulting mean number of steps
-  void print_results(std::ofstream & output_file) const;
+  // Returns the header of the trajectory file of the walks on grid
+  util::TrajectoryHeader trajectory_header(const Grid * grid) const;
+
+  // Returns the header of the shard files of this walk parameters file
+  util::ShardHeader shard_header(
+    const Grid * grid, unsigned int shard, unsigned int num_shards,
+    util::shard_mode mode) const;
+
+  // Walks one shard of the analog and all biased cases of the input file,
+  // writing partial results that gridwalk_merge combines into the results
+  // of shard 0 of 1. Simulated annealing cannot be sharded.
+  void execute_shard(
+    Grid * grid, util::ShardWriter & writer, const util::ShardHeader & header);
+
+  // Calls either run_all_cases or simulate_annealing depending on user input
+  // and writes the results of each case as it completes
+  void execute(Grid * grid, util::ResultsSink & results);
 };
 
 #endif
\ No newline at end of file
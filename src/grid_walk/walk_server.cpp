@@ -0,0 +1,372 @@
+#include "walk_server.hpp"
+#include "mc_walk.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRIDWALK_HAS_UNIX_SOCKETS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+WalkServer::WalkServer(unsigned int num_workers, size_t cache_size)
+  : _cache_size(cache_size), _pool(num_workers) {}
+
+void WalkServer::load_grid(
+    const std::string & grid_id, const std::string & filename) {
+  std::ifstream grid_input(filename, std::ios::in | std::ios::binary);
+  if (!grid_input.is_open()) {
+    throw std::runtime_error("Failed to open "+filename);
+  }
+  auto grid = std::make_shared<Grid>(grid_input);
+  // Classify the grid before workers share it
+  grid->goal_reachable();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _grids[grid_id] = {grid, nullptr, {}, _next_generation++};
+}
+
+// Walks take their grid under the server lock, so a grid held only by the
+// server stays unused until the lock is released
+static bool is_unused(const std::shared_ptr<Grid> & grid) {
+  if (grid.use_count() != 1) { return false; }
+  // Order the reads of the finished walks before the changes that follow
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+}
+
+size_t WalkServer::set_reachable(
+    const std::string & grid_id, const util::Coord & first,
+    const util::Coord & last, bool reachable) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto entry = _grids.find(grid_id);
+  if (entry == _grids.end()) {
+    throw std::runtime_error("Unknown grid "+grid_id);
+  }
+  GridEntry & grid_entry = entry->second;
+  std::shared_ptr<Grid> grid = grid_entry._grid;
+  if (!is_unused(grid)) {
+    std::shared_ptr<Grid> & spare = grid_entry._spare;
+    if (spare && is_unused(spare)) {
+      for (const auto & change : grid_entry._pending) {
+        spare->set_reachable(change._first, change._last, change._reachable);
+      }
+      grid = spare;
+    }
+    else {
+      grid = std::make_shared<Grid>(grid_entry._grid.get());
+    }
+    spare = grid_entry._grid;
+    grid_entry._pending.clear();
+    grid_entry._grid = grid;
+  }
+  size_t num_changed = grid->set_reachable(first, last, reachable);
+  if (num_changed > 0) {
+    grid->goal_reachable();
+    grid_entry._generation = _next_generation++;
+    grid_entry._pending.push_back({first, last, reachable});
+    if (grid_entry._pending.size() > max_pending_changes) {
+      grid_entry._spare.reset();
+      grid_entry._pending.clear();
+    }
+  }
+  return num_changed;
+}
+
+bool WalkServer::handle(const std::string & line, Responder respond) {
+  std::stringstream request(line);
+  std::string command;
+  if (!(request >> command)) { return true; }
+  std::string tag = "-";
+  try {
+    if (command == "walk") {
+      std::string grid_id;
+      double num_samples, seed;
+      std::vector<double> params(util::num_PMF_params);
+      request >> tag >> grid_id >> num_samples >> seed;
+      for (auto & param : params) { request >> param; }
+      if (!request || num_samples < 1) {
+        throw std::runtime_error("Malformed walk request");
+      }
+      walk(tag, grid_id, num_samples, seed, params, respond);
+    }
+    else if (command == "load") {
+      std::string grid_id, filename;
+      if (!(request >> grid_id >> filename)) {
+        throw std::runtime_error("Malformed load request");
+      }
+      tag = grid_id;
+      load_grid(grid_id, filename);
+      std::lock_guard<std::mutex> lock(_mutex);
+      const Grid & grid = *_grids[grid_id]._grid;
+      respond("loaded "+grid_id+" "+std::to_string(grid.get_x_dim())+" "+
+              std::to_string(grid.get_y_dim()));
+    }
+    else if (command == "set") {
+      std::string grid_id;
+      bool reachable;
+      unsigned int x, y;
+      if (!(request >> grid_id >> reachable >> x >> y)) {
+        throw std::runtime_error("Malformed set request");
+      }
+      tag = grid_id;
+      unsigned int last_x = x, last_y = y;
+      if (request >> last_x) {
+        if (!(request >> last_y)) {
+          throw std::runtime_error("Malformed set request");
+        }
+      }
+      size_t num_changed = set_reachable(grid_id, util::Coord(x, y),
+                                         util::Coord(last_x, last_y),
+                                         reachable);
+      std::lock_guard<std::mutex> lock(_mutex);
+      respond("updated "+grid_id+" "+std::to_string(num_changed)+" "+
+              std::to_string(_grids[grid_id]._grid->goal_reachable()));
+    }
+    else if (command == "stats") {
+      std::lock_guard<std::mutex> lock(_mutex);
+      respond("stats grids "+std::to_string(_grids.size())+" requests "+
+              std::to_string(_num_requests)+" cache_hits "+
+              std::to_string(_num_hits)+" cached "+
+              std::to_string(_cache.size()));
+    }
+    else if (command == "quit") {
+      return false;
+    }
+    else if (command == "shutdown") {
+      _shutdown = true;
+      return false;
+    }
+    else {
+      throw std::runtime_error("Unknown request "+command);
+    }
+  }
+  catch (const std::exception & e) {
+    respond("error "+tag+" "+e.what());
+  }
+  return true;
+}
+
+// Formats the response to a walk request
+static std::string result_line(
+    const std::string & tag, const util::CaseResult & result, bool cached) {
+  std::stringstream line;
+  line << std::setprecision(10) << "result " << tag << " " << result._mean;
+  line << " " << result._error << " " << result._samples << " ";
+  line << result._runtime << " " << cached;
+  return line.str();
+}
+
+void WalkServer::walk(
+    const std::string & tag, const std::string & grid_id,
+    double num_samples, double seed, const std::vector<double> & params,
+    Responder respond) {
+  // Look up the grid and any memoized result of the same request
+  std::shared_ptr<Grid> grid;
+  std::stringstream key;
+  util::CacheRecord record;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto entry = _grids.find(grid_id);
+    if (entry == _grids.end()) {
+      throw std::runtime_error("Unknown grid "+grid_id);
+    }
+    grid = entry->second._grid;
+    key << std::setprecision(17) << entry->second._generation << " ";
+    key << num_samples << " " << seed;
+    for (double param : params) { key << " " << param; }
+    ++_num_requests;
+    auto cached = _cache.find(key.str());
+    if (cached != _cache.end()) {
+      ++_num_hits;
+      respond(result_line(tag, cached->second, true));
+      return;
+    }
+    record._samples = num_samples;
+    record._seed = seed;
+    std::copy(params.begin(), params.end(), record._params);
+    // The hash is only computed for grids checked against the cache
+    if (_result_cache != nullptr) { record._grid_hash = grid->hash(); }
+    if (_result_cache != nullptr && _result_cache->find(record)) {
+      ++_num_hits;
+      util::CaseResult result;
+      std::copy(params.begin(), params.end(), result._params);
+      result._mean = record._mean;
+      result._error = record._error;
+      result._samples = num_samples;
+      result._runtime = record._runtime;
+      respond(result_line(tag, result, true));
+      return;
+    }
+  }
+
+  _pool.submit([this, tag, grid, key = key.str(), record, num_samples, seed,
+                params, respond]() mutable {
+    try {
+      // Walks only read the grid so workers share it
+      MCWalk walk(grid.get());
+      walk.set_verbose(false);
+      walk.set_seed(seed);
+      walk.reset();
+      walk.set_biased_PMF(params);
+      util::CaseResult result;
+      std::copy(params.begin(), params.end(), result._params);
+      auto start = std::chrono::steady_clock::now();
+      result._mean = walk.walk_grid(num_samples);
+      result._runtime = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+      result._error = walk.get_error();
+      result._samples = num_samples;
+      // Release the grid so the next change can be made to it in place
+      grid.reset();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_result_cache != nullptr) {
+          record._mean = result._mean;
+          record._error = result._error;
+          record._FOM = walk.get_FOM();
+          record._runtime = result._runtime;
+          _result_cache->insert(record);
+        }
+        if (_cache_size > 0 && _cache.emplace(key, result).second) {
+          _cache_order.push_back(key);
+          if (_cache_order.size() > _cache_size) {
+            _cache.erase(_cache_order.front());
+            _cache_order.pop_front();
+          }
+        }
+      }
+      respond(result_line(tag, result, false));
+    }
+    catch (const std::exception & e) {
+      respond("error "+tag+" "+e.what());
+    }
+  });
+}
+
+void WalkServer::serve_stream(std::istream & input, std::ostream & output) {
+  std::mutex output_mutex;
+  Responder respond = [&output, &output_mutex](const std::string & line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    output << line << std::endl;
+  };
+  std::string line;
+  while (std::getline(input, line) && handle(line, respond)) {}
+  // Responses reference the output so all walks must finish first
+  wait();
+}
+
+#ifdef GRIDWALK_HAS_UNIX_SOCKETS
+
+// Connection of a client, closed once the session has ended and the last
+// response has been sent
+struct Session {
+  int _fd;
+  std::mutex _mutex;
+  Session(int fd) : _fd(fd) {}
+  ~Session() { ::close(_fd); }
+
+  void send(const std::string & line) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string data = line+"\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = ::send(
+        _fd, data.data()+sent, data.size()-sent, MSG_NOSIGNAL);
+      if (n <= 0) { return; }
+      sent += n;
+    }
+  }
+};
+
+void WalkServer::serve_socket(const std::string & path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path is too long: "+path);
+  }
+  std::copy(path.begin(), path.end(), address.sun_path);
+  int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(path.c_str());
+  if (listen_fd < 0 ||
+      ::bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listen_fd, 64) != 0) {
+    if (listen_fd >= 0) { ::close(listen_fd); }
+    throw std::runtime_error("Failed to listen on "+path);
+  }
+
+  // Sessions of the clients, connections run on detached threads
+  std::mutex session_mutex;
+  std::condition_variable session_closed;
+  std::vector<std::weak_ptr<Session>> sessions;
+  unsigned int num_connections = 0;
+  while (!_shutdown) {
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) { break; }
+    auto session = std::make_shared<Session>(fd);
+    {
+      std::lock_guard<std::mutex> lock(session_mutex);
+      sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+        [](const std::weak_ptr<Session> & s) { return s.expired(); }),
+        sessions.end());
+      sessions.push_back(session);
+      ++num_connections;
+    }
+    std::thread([&, session]() {
+      Responder respond = [session](const std::string & line) {
+        session->send(line);
+      };
+      std::string pending;
+      char buffer[4096];
+      bool open = true;
+      while (open) {
+        ssize_t n = ::recv(session->_fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) { break; }
+        pending.append(buffer, n);
+        size_t end;
+        while (open && (end = pending.find('\n')) != pending.npos) {
+          open = handle(pending.substr(0, end), respond);
+          pending.erase(0, end+1);
+        }
+      }
+      // Wake the accept loop so a shutdown request takes effect
+      if (_shutdown) { ::shutdown(listen_fd, SHUT_RDWR); }
+      std::lock_guard<std::mutex> lock(session_mutex);
+      --num_connections;
+      session_closed.notify_all();
+    }).detach();
+  }
+
+  // Stop reading from the remaining clients and finish their walks
+  std::unique_lock<std::mutex> lock(session_mutex);
+  for (auto & weak_session : sessions) {
+    if (auto session = weak_session.lock()) {
+      ::shutdown(session->_fd, SHUT_RD);
+    }
+  }
+  session_closed.wait(lock, [&]() { return num_connections == 0; });
+  lock.unlock();
+  wait();
+  ::close(listen_fd);
+  ::unlink(path.c_str());
+}
+
+#else
+
+void WalkServer::serve_socket(const std::string & path) {
+  throw std::runtime_error("Unix domain sockets are not supported");
+}
+
+#endif
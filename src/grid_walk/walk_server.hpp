@@ -0,0 +1,136 @@
+#ifndef _WALK_SERVER_HEADER_
+#define _WALK_SERVER_HEADER_
+
+#include "util/grid.hpp"
+#include "util/result_cache.hpp"
+#include "util/results_writer.hpp"
+#include "util/worker_pool.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Long running evaluation server keeping parsed grids resident. Requests are
+// read as lines of text, walks are run on a pool of worker threads, and the
+// results of each distinct request are memoized.
+//
+// Request Protocol, one request per line:
+// load [grid_id] [grid_file]
+//   -> loaded [grid_id] [x_dim] [y_dim]
+// set [grid_id] [0/1] [x] [y] ([last_x] [last_y])
+//   -> updated [grid_id] [changed nodes] [goal reachable 0/1]
+// walk [tag] [grid_id] [samples] [seed] [direction pmf] [distance pmf]
+//   -> result [tag] [mean] [error] [samples] [runtime] [cached 0/1]
+// stats
+//   -> stats grids [n] requests [n] cache_hits [n] cached [n]
+// quit
+//   ends the session
+// shutdown
+//   ends the session and stops a socket server
+// Failed requests respond with: error [tag or -] [message]
+// Walk results are sent as each walk finishes so they may arrive out of
+// order, the tag chosen by the client matches results to requests. A set
+// request makes the node x, y, or the rectangle from x, y to last_x, last_y,
+// reachable (1) or blocked (0); walks requested after it see the change while
+// walks already running finish on the grid as it was.
+class WalkServer {
+public:
+  // Receives one response line, may be called from any worker thread
+  typedef std::function<void(const std::string &)> Responder;
+
+private:
+  // Change of reachability of a rectangle of nodes, see Grid::set_reachable
+  struct Change {
+    util::Coord _first, _last;
+    bool _reachable;
+  };
+  // Grid resident in the server, the generation changes when the grid id is
+  // reloaded or changed so stale memoized results are never returned
+  struct GridEntry {
+    // Grid new walks start on
+    std::shared_ptr<Grid> _grid;
+    // Grid replaced by the last change walks were running on, brought up to
+    // date for the next such change once no walk runs on it, null if none
+    std::shared_ptr<Grid> _spare;
+    // Changes made to _grid since it matched _spare
+    std::vector<Change> _pending;
+    unsigned long long _generation;
+  };
+  // Most changes kept to bring a spare grid up to date, past which the
+  // spare is dropped and copied anew
+  static const size_t max_pending_changes = 64;
+  // Grids by id
+  std::unordered_map<std::string, GridEntry> _grids;
+  // Generation given to the next loaded grid
+  unsigned long long _next_generation = 0;
+  // Memoized results by request key, oldest entries are evicted first
+  std::unordered_map<std::string, util::CaseResult> _cache;
+  std::deque<std::string> _cache_order;
+  // Max number of memoized results
+  size_t _cache_size;
+  // Persistent cache shared with other runs, not owned
+  util::ResultCache * _result_cache = nullptr;
+  // Number of walk requests and of those answered from the cache
+  unsigned long long _num_requests = 0;
+  unsigned long long _num_hits = 0;
+  // Guards the grids, cache, and counters
+  std::mutex _mutex;
+  // Set by a shutdown request
+  std::atomic<bool> _shutdown{false};
+  // Workers running the walks
+  util::WorkerPool _pool;
+
+  // Run a walk request on a worker
+  void walk(
+    const std::string & tag, const std::string & grid_id,
+    double num_samples, double seed, const std::vector<double> & params,
+    Responder respond);
+
+public:
+  // Start num_workers workers, 0 uses all hardware threads
+  WalkServer(unsigned int num_workers = 0, size_t cache_size = 1 << 16);
+  ~WalkServer() {};
+
+  // Load a grid file and make it available under grid_id, replacing any
+  // grid previously loaded under the id
+  void load_grid(const std::string & grid_id, const std::string & filename);
+
+  // Set the reachability of the rectangle of nodes from first to last of the
+  // grid grid_id under a new generation. The grid is updated in place if no
+  // walk runs on it. Otherwise the change is made to the spare grid, after
+  // the changes it missed, or to a copy if walks also run on the spare, so
+  // running walks keep the grid they started on. Returns the number of
+  // nodes changed.
+  size_t set_reachable(
+    const std::string & grid_id, const util::Coord & first,
+    const util::Coord & last, bool reachable);
+
+  // Set a persistent cache checked after the memoized results and updated
+  // with every walk
+  void set_result_cache(util::ResultCache * result_cache) {
+    _result_cache = result_cache;
+  }
+
+  // Handle one request line, returns false if the line ends the session
+  bool handle(const std::string & line, Responder respond);
+
+  // Block until all submitted walks have responded
+  void wait() { _pool.wait(); }
+
+  // Serve requests read from input, writing responses to output, until the
+  // input ends or a quit request
+  void serve_stream(std::istream & input, std::ostream & output);
+
+  // Serve connections on a Unix domain socket at path, one session per
+  // connection, until a shutdown request
+  void serve_socket(const std::string & path);
+};
+
+#endif
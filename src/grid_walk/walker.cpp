@@ -1,6 +1,7 @@
 #include "walker.hpp"
 
 #include "util/dist.hpp"
+#include "util/perf_counters.hpp"
 
 #include <cmath>
 #include <iomanip>
@@ -8,35 +9,30 @@
 
 // Samples a direction to walk in randomly
 util::direction Walker::sample_dir(const Grid * grid) {
-  // Get the possible directions from the grid
-  std::vector<util::direction> possible_dirs = 
-    grid->get_directions(_position);
-
-  // If all direction are possible, sample the direction to take
-  unsigned int dir_idx;
-  std::vector<double> possible_dir_probs;
-  if (possible_dirs.size() == util::all_directions.size()) {
-    possible_dir_probs = _direction_probabilities;
-    dir_idx = _prob_distributions.sample(
-      possible_dir_probs, util::dist_type::categorical);
-  }
-  // Otherwise construct a vector of only possible direction probabilies
-  // and sample direction from it
-  else {
-    for (const auto dir : possible_dirs) {
-      possible_dir_probs.push_back(_direction_probabilities[dir]);
+  // Get the possible directions from the grid, in the order of the enum
+  const uint8_t mask = grid->get_direction_mask(_position);
+  util::direction possible_dirs[util::all_directions.size()];
+  double possible_dir_probs[util::all_directions.size()];
+  unsigned int num_dirs = 0;
+  for (const auto dir : util::all_directions) {
+    if (mask & (1 << dir)) {
+      possible_dirs[num_dirs] = dir;
+      possible_dir_probs[num_dirs++] = _direction_probabilities[dir];
     }
-    dir_idx = _prob_distributions.sample(
-      possible_dir_probs, util::dist_type::categorical);
   }
+  PERF_COUNT(++util::perf_counters()._num_directions[num_dirs]);
+
+  // Sample the direction to take from only the possible directions
+  unsigned int dir_idx = _prob_distributions.sample(
+    possible_dir_probs, num_dirs, util::dist_type::categorical);
 
   // Adjust the weight to match analog case, analog direction is equiprobable
   // [no longer used, importance sampling commented out]
   if (_biased_walk) {
     // analog prob is 1/num_dirs
     double bias_ratio = 1.0 / (_prob_distributions.evaluate(
-        possible_dir_probs, dir_idx, util::dist_type::categorical) *
-        possible_dir_probs.size());
+        std::vector<double>(possible_dir_probs, possible_dir_probs+num_dirs),
+        dir_idx, util::dist_type::categorical) * num_dirs);
     _weight *= bias_ratio;
   }
 
@@ -70,7 +66,7 @@ unsigned int Walker::sample_dist(const Grid * grid, const util::direction dir){
 void Walker::set_biased_PMF(const std::vector<double> &probabilities) {
   // Importance sampling commented out
   // _biased_walk = true;
-  _direction_probabilities = std::vector<double>(
+  _direction_probabilities.assign(
     probabilities.begin(), probabilities.end()-1);
   _lambda = probabilities.back();
 }
@@ -78,11 +74,21 @@ void Walker::set_biased_PMF(const std::vector<double> &probabilities) {
 // Randomly samples the next grid node of the walker
 void Walker::step(const Grid * grid) {
   // Sample the direction to move in
-  auto dir = sample_dir(grid);
+  util::direction dir;
+  {
+    PERF_COUNT(util::ScopedTimer timer(util::perf_counters()._direction_ns));
+    dir = sample_dir(grid);
+  }
   // Sample the number of node to traverse in that direction
-  auto dist = sample_dist(grid, dir);
+  unsigned int dist;
+  {
+    PERF_COUNT(util::ScopedTimer timer(util::perf_counters()._distance_ns));
+    dist = sample_dist(grid, dir);
+  }
   // Move the walker to the new node
   _position += util::to_increment(dir)*dist;
+  _last_dir = dir;
+  _last_dist = dist;
 }
 
 void Walker::print_PMF_paramters() const {
@@ -23,8 +23,13 @@ private:
   std::vector<double> _direction_probabilities;
   // Current position
   util::Coord _position;
+  // Direction and distance of the last step
+  util::direction _last_dir = util::direction::north;
+  unsigned int _last_dist = 0;
   // Probability denisty function object
   util::PDF _prob_distributions;
+  // Seed the RNG is reset to
+  double _seed = default_seed;
 
   // Returns a randomly sampled direction from all possible directions
   // according to the probability of each
@@ -35,6 +40,9 @@ private:
   unsigned int sample_dist(const Grid * grid, const util::direction dir);
 
 public: 
+  // Seed of the RNG unless set otherwise
+  static constexpr double default_seed = 16180339;
+
   Walker() : _prob_distributions(util::RNG()) {
   _direction_probabilities.resize(8);
   std::fill(
@@ -45,9 +53,23 @@ public:
   // Sets the weight to one and resets the RNG to the initial state
   void reset() {
     _weight = 1.0;
-    _prob_distributions.reset_rng();
+    _prob_distributions.reset_rng(_seed);
+  }
+
+  // Resets the RNG to substream stream of the seed
+  void reset_stream(uint64_t stream) {
+    _prob_distributions.reset_rng(_seed, stream);
   }
 
+  // Returns the RNG driving every decision of the walker
+  util::RNG & get_rng() { return _prob_distributions.get_rng(); }
+
+  // Set the seed the RNG is reset to, applied by the next reset
+  void set_seed(double seed) { _seed = seed; }
+
+  // Return the seed the RNG is reset to
+  double get_seed() const { return _seed; }
+
   // Reset the weight of the particle to one
   // [no longer used, importance sampling commented out]
   void reset_weight() { _weight = 1.0; }
@@ -63,6 +85,9 @@ public:
   // Modify the position
   void set_position(util::Coord start) { _position = start; }
 
+  // Return the current position
+  const util::Coord & get_position() const { return _position; }
+
   // Return the weight of the walker
   // [no longer used, importance sampling commented out]
   const double get_weight() const { return _weight; }
@@ -74,6 +99,17 @@ public:
   // weight accordingly
   void step(const Grid * grid);
 
+  // Return the direction of the last step
+  util::direction get_last_dir() const { return _last_dir; }
+
+  // Return the number of nodes travelled by the last step
+  unsigned int get_last_dist() const { return _last_dist; }
+
+  // Tally the nodes traversed by the last step on the grid
+  void visit_path(Grid * grid) const {
+    grid->visit_path(_position, _last_dir, _last_dist);
+  }
+
   // Call visit on the grid at the current position
   void visit_grid(Grid * grid) const { grid->visit(_position); }
 
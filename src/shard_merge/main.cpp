@@ -0,0 +1,226 @@
+// Merges the partial results written by gridwalk --shard into the results of
+// a single run
+#include "util/npy_writer.hpp"
+#include "util/results_writer.hpp"
+#include "util/shard_file.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_merge shard_file... [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --format csv|binary  results file format (default csv)\n";
+  std::cout << "  --output file        results file name (default ";
+  std::cout << "merged_results.csv)\n";
+  std::cout << "  --visits file        spatial distributions .npy file, when ";
+  std::cout << "tallied\n";
+  std::cout << "  --downsample k       sum spatial distributions over k x k ";
+  std::cout << "blocks (default 1)\n";
+  std::cout << "  --histograms file    CSV of the log2 histogram of steps ";
+  std::cout << "per history of each case" << std::endl;
+}
+
+// Throws unless the shard belongs to the same run as the first shard
+static void check_header(
+    const util::ShardHeader & first, const util::ShardHeader & header) {
+  if (header._num_shards != first._num_shards ||
+      header._mode != first._mode ||
+      header._num_cases != first._num_cases ||
+      header._engine_version != first._engine_version ||
+      header._grid_hash != first._grid_hash ||
+      header._options_hash != first._options_hash ||
+      header._num_samples != first._num_samples ||
+      header._seed != first._seed) {
+    throw std::runtime_error("Shards belong to different runs");
+  }
+}
+
+// Average visits per history over downsample x downsample blocks, matching
+// Grid::get_visit_map
+static void visit_map(
+    const util::ShardHeader & header, const util::ShardRecord & record,
+    unsigned int downsample, std::vector<float> & map) {
+  unsigned int map_x_dim = (header._x_dim + downsample - 1) / downsample;
+  unsigned int map_y_dim = (header._y_dim + downsample - 1) / downsample;
+  map.assign(static_cast<size_t>(map_x_dim)*map_y_dim, 0.0f);
+  for (uint64_t y = 0; y < header._y_dim; y++) {
+    for (uint64_t x = 0; x < header._x_dim; x++) {
+      map[(y/downsample)*map_x_dim + x/downsample] +=
+        record._visits[y*header._x_dim + x] / header._num_samples;
+    }
+  }
+}
+
+int main(int argc, char* argv []) {
+  std::vector<std::string> shard_filenames;
+  util::results_format format = util::results_format::csv;
+  std::string output_filename;
+  std::string visits_filename;
+  std::string histograms_filename;
+  unsigned int downsample = 1;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string option(argv[i]);
+      if (option.compare(0, 2, "--") != 0) {
+        shard_filenames.push_back(option);
+        continue;
+      }
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--format") {
+        format = util::to_results_format(argv[++i]);
+      }
+      else if (option == "--output") { output_filename = argv[++i]; }
+      else if (option == "--visits") { visits_filename = argv[++i]; }
+      else if (option == "--histograms") { histograms_filename = argv[++i]; }
+      else if (option == "--downsample") {
+        int value = std::stoi(argv[++i]);
+        if (value < 1) {
+          throw std::runtime_error("Downsample factor must be positive");
+        }
+        downsample = value;
+      }
+      else { throw std::runtime_error("Unknown option "+option); }
+    }
+    if (shard_filenames.empty()) {
+      throw std::runtime_error("No shard files passed");
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
+    return 1;
+  }
+  if (output_filename.empty()) {
+    output_filename = (format == util::results_format::binary) ?
+      "merged_results.bin" : "merged_results.csv";
+  }
+
+  try {
+    // Sum the partial results of each case over all shards
+    util::ShardHeader first;
+    std::vector<bool> seen;
+    std::map<uint64_t, util::ShardRecord> cases;
+    // Shards each case was read from, to catch cases walked twice
+    std::map<uint64_t, uint64_t> case_shards;
+    for (size_t f = 0; f < shard_filenames.size(); f++) {
+      util::ShardReader reader(shard_filenames[f]);
+      const util::ShardHeader & header = reader.header();
+      if (f == 0) {
+        first = header;
+        seen.assign(first._num_shards, false);
+      }
+      check_header(first, header);
+      if (seen[header._shard]) {
+        throw std::runtime_error(
+          "Shard "+std::to_string(header._shard)+" passed twice");
+      }
+      seen[header._shard] = true;
+      const bool split_histories =
+        header._mode == util::shard_mode::shard_histories;
+      uint64_t num_records = 0;
+      util::ShardRecord record;
+      while (reader.read(record)) {
+        num_records++;
+        if (record._case_idx >= header._num_cases ||
+            (!split_histories &&
+             record._case_idx % header._num_shards != header._shard) ||
+            case_shards[record._case_idx]++ != (split_histories ? f : 0)) {
+          throw std::runtime_error(
+            "Case "+std::to_string(record._case_idx)+
+            " is repeated or does not belong to shard "+
+            std::to_string(header._shard));
+        }
+        auto merged = cases.find(record._case_idx);
+        if (merged == cases.end()) { cases[record._case_idx] = record; }
+        else { merged->second.merge(record); }
+      }
+      if (num_records != header._num_records) {
+        throw std::runtime_error(
+          "Shard file "+shard_filenames[f]+" holds "+
+          std::to_string(num_records)+" of "+
+          std::to_string(header._num_records)+" cases");
+      }
+    }
+    for (size_t s = 0; s < seen.size(); s++) {
+      if (!seen[s]) {
+        throw std::runtime_error("Shard "+std::to_string(s)+" is missing");
+      }
+    }
+    if (cases.size() != first._num_cases) {
+      throw std::runtime_error(
+        "Shards hold "+std::to_string(cases.size())+" of "+
+        std::to_string(first._num_cases)+" cases");
+    }
+
+    util::ResultsWriter results(output_filename, format);
+    if (!results.is_open()) {
+      throw std::runtime_error("Failed to open "+output_filename);
+    }
+    std::unique_ptr<util::NpyWriter> visits;
+    if (!visits_filename.empty()) {
+      visits = std::make_unique<util::NpyWriter>(visits_filename,
+        (first._x_dim + downsample - 1) / downsample,
+        (first._y_dim + downsample - 1) / downsample);
+      if (!visits->is_open()) {
+        throw std::runtime_error("Failed to open "+visits_filename);
+      }
+    }
+    std::ofstream histograms;
+    if (!histograms_filename.empty()) {
+      histograms.open(histograms_filename);
+      if (!histograms.is_open()) {
+        throw std::runtime_error("Failed to open "+histograms_filename);
+      }
+    }
+
+    // Write the cases in input file order
+    std::vector<float> map;
+    for (const auto & entry : cases) {
+      const util::ShardRecord & record = entry.second;
+      const util::WalkMoments & moments = record._moments;
+      if (!moments._aborted &&
+          moments._histories != static_cast<uint64_t>(first._num_samples)) {
+        throw std::runtime_error(
+          "Case "+std::to_string(entry.first)+" is missing histories");
+      }
+      util::CaseResult result;
+      std::copy(record._params, record._params+util::num_PMF_params,
+                result._params);
+      result._mean = moments.mean(first._max_steps);
+      result._error = std::sqrt(moments.mean_variance());
+      result._samples = first._num_samples;
+      result._runtime = record._runtime;
+      results.write(result);
+      if (visits && !record._visits.empty()) {
+        visit_map(first, record, downsample, map);
+        visits->write(map);
+      }
+      if (histograms.is_open()) {
+        histograms << entry.first;
+        for (int b = 0; b < util::num_step_bins; b++) {
+          histograms << "," << moments._step_histogram[b];
+        }
+        histograms << "\n";
+      }
+    }
+    std::cout << "Merged " << shard_filenames.size() << " shards of ";
+    std::cout << cases.size() << " cases into " << output_filename;
+    std::cout << std::endl;
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
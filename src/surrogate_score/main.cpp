@@ -0,0 +1,152 @@
+// Scores PMF parameter candidates with a surrogate model exported by
+// gridwalkopt, without mlpack or armadillo
+#include "util/mlp.hpp"
+#include "util/rand.hpp"
+#include "util/results_writer.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_score model_file [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --input file     CSV of candidates, 9 PMF parameters per ";
+  std::cout << "row\n";
+  std::cout << "  --random n       score n random candidates and report the ";
+  std::cout << "throughput\n";
+  std::cout << "  --threads n      scoring threads, 0 uses all (default 0)\n";
+  std::cout << "  --output file    predictions, one per line (default ";
+  std::cout << "stdout)" << std::endl;
+}
+
+// Reads rows of comma separated PMF parameters, extra columns such as the
+// results written by gridwalk are ignored
+static void read_candidates(
+    const std::string & filename, std::vector<float> & candidates) {
+  std::ifstream input_file(filename);
+  if (!input_file.is_open()) {
+    throw std::runtime_error("Failed to open "+filename);
+  }
+  std::string line;
+  while (std::getline(input_file, line)) {
+    if (line.empty() || line == "\r") { continue; }
+    std::stringstream line_stream(line);
+    std::string value;
+    for (unsigned int i = 0; i < util::num_PMF_params; i++) {
+      if (!std::getline(line_stream, value, ',')) {
+        throw std::runtime_error("Candidate row has too few values: "+line);
+      }
+      candidates.push_back(std::stof(value));
+    }
+  }
+}
+
+// Random candidates with uniformly distributed direction probabilities and a
+// distance parameter in [1, 3]
+static void random_candidates(
+    size_t num_candidates, std::vector<float> & candidates) {
+  util::RNG rng;
+  candidates.resize(num_candidates*util::num_PMF_params);
+  for (size_t c = 0; c < num_candidates; c++) {
+    float * params = candidates.data() + c*util::num_PMF_params;
+    float total = 0;
+    for (unsigned int i = 0; i < util::num_PMF_params-1; i++) {
+      params[i] = -std::log(1.0 - rng.sample()*(1.0 - 1e-12));
+      total += params[i];
+    }
+    for (unsigned int i = 0; i < util::num_PMF_params-1; i++) {
+      params[i] /= total;
+    }
+    params[util::num_PMF_params-1] = 1.0 + 2.0*rng.sample();
+  }
+}
+
+int main(int argc, char* argv []) {
+  if (argc < 2) {
+    print_usage();
+    return 1;
+  }
+  std::string input_filename;
+  std::string output_filename;
+  size_t num_random = 0;
+  unsigned int num_threads = 0;
+  try {
+    for (int i = 2; i < argc; i++) {
+      std::string option(argv[i]);
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--input") { input_filename = argv[++i]; }
+      else if (option == "--random") { num_random = std::stoull(argv[++i]); }
+      else if (option == "--threads") { num_threads = std::stoul(argv[++i]); }
+      else if (option == "--output") { output_filename = argv[++i]; }
+      else { throw std::runtime_error("Unknown option "+option); }
+    }
+    if (input_filename.empty() == (num_random == 0)) {
+      throw std::runtime_error("Pass exactly one of --input and --random");
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  try {
+    util::MLP model(argv[1]);
+    if (model.num_inputs() != util::num_PMF_params) {
+      throw std::runtime_error("Model does not take 9 PMF parameters");
+    }
+    std::vector<float> candidates;
+    if (num_random > 0) { random_candidates(num_random, candidates); }
+    else { read_candidates(input_filename, candidates); }
+    size_t num_candidates = candidates.size()/util::num_PMF_params;
+    std::vector<float> predictions(num_candidates);
+
+    auto start = std::chrono::steady_clock::now();
+    model.predict(
+      candidates.data(), num_candidates, predictions.data(), num_threads);
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+    if (num_random > 0) {
+      size_t best = 0;
+      for (size_t c = 1; c < num_candidates; c++) {
+        if (predictions[c] < predictions[best]) { best = c; }
+      }
+      std::cout << "Scored " << num_candidates << " candidates in ";
+      std::cout << seconds << " s (" << num_candidates/seconds;
+      std::cout << " candidates/s)\n";
+      std::cout << "Best predicted mean " << predictions[best] << " for";
+      for (unsigned int i = 0; i < util::num_PMF_params; i++) {
+        std::cout << " " << candidates[best*util::num_PMF_params+i];
+      }
+      std::cout << std::endl;
+    }
+    if (!output_filename.empty() || num_random == 0) {
+      std::ofstream output_file;
+      if (!output_filename.empty()) {
+        output_file.open(output_filename);
+        if (!output_file.is_open()) {
+          throw std::runtime_error("Failed to open "+output_filename);
+        }
+      }
+      std::ostream & output = output_filename.empty() ?
+        std::cout : output_file;
+      for (float prediction : predictions) { output << prediction << "\n"; }
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+// Replays the histories recorded by gridwalk --record, filtering them and
+// tallying their steps and spatial distributions offline
+#include "util/npy_writer.hpp"
+#include "util/trajectory_file.hpp"
+#include "util/walk_moments.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_replay trajectory_file [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --case i             replay case i of the walk parameters ";
+  std::cout << "file only\n";
+  std::cout << "  --histories a:b      replay histories a to b-1 of each ";
+  std::cout << "case only\n";
+  std::cout << "  --min-steps n        replay histories of at least n steps\n";
+  std::cout << "  --max-steps n        replay histories of at most n steps\n";
+  std::cout << "  --through x,y        replay histories passing through ";
+  std::cout << "node x,y only\n";
+  std::cout << "  --tally endpoint|path  tally the node each step ends at ";
+  std::cout << "or every node it crosses (default endpoint)\n";
+  std::cout << "  --visits file        spatial distributions .npy file of ";
+  std::cout << "the replayed histories\n";
+  std::cout << "  --downsample k       sum spatial distributions over k x k ";
+  std::cout << "blocks (default 1)\n";
+  std::cout << "  --print n            print the moves of the first n ";
+  std::cout << "replayed histories" << std::endl;
+}
+
+// Parses "a,b" or "a:b" into two unsigned values
+static void to_pair(const std::string & value, char separator,
+                    unsigned long long & first, unsigned long long & second) {
+  size_t split = value.find(separator);
+  if (split == std::string::npos) {
+    throw std::runtime_error(
+      "Expected two values separated by "+std::string(1, separator)+
+      ", got "+value);
+  }
+  first = std::stoull(value.substr(0, split));
+  second = std::stoull(value.substr(split+1));
+}
+
+// Calls visit(x, y) for every node crossed by a move of dist nodes in dir
+// ending at end, excluding the node the move started from
+template <typename Visit>
+static void for_path(const util::Coord & end, util::direction dir,
+                     unsigned int dist, Visit visit) {
+  long long dx = util::Lattice<2>::increments[dir][0];
+  long long dy = util::Lattice<2>::increments[dir][1];
+  for (unsigned int d = 0; d < dist; d++) {
+    visit(end._x_coord - dx*d, end._y_coord - dy*d);
+  }
+}
+
+int main(int argc, char* argv []) {
+  if (argc < 2) {
+    std::cout << "Must pass a trajectory file" << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  // Parse optional arguments
+  bool one_case = false;
+  unsigned long long case_idx = 0;
+  unsigned long long first_history = 0;
+  unsigned long long last_history = std::numeric_limits<uint64_t>::max();
+  unsigned long long min_steps = 0;
+  unsigned long long max_steps = std::numeric_limits<uint64_t>::max();
+  bool through = false;
+  unsigned long long through_x = 0, through_y = 0;
+  bool path_tally = false;
+  std::string visits_filename;
+  unsigned int downsample = 1;
+  unsigned long long num_print = 0;
+  try {
+    for (int i = 2; i < argc; i++) {
+      std::string option(argv[i]);
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--case") {
+        case_idx = std::stoull(argv[++i]);
+        one_case = true;
+      }
+      else if (option == "--histories") {
+        to_pair(argv[++i], ':', first_history, last_history);
+      }
+      else if (option == "--min-steps") { min_steps = std::stoull(argv[++i]); }
+      else if (option == "--max-steps") { max_steps = std::stoull(argv[++i]); }
+      else if (option == "--through") {
+        to_pair(argv[++i], ',', through_x, through_y);
+        through = true;
+      }
+      else if (option == "--tally") {
+        std::string tally(argv[++i]);
+        if (tally != "endpoint" && tally != "path") {
+          throw std::runtime_error("Unknown tally "+tally);
+        }
+        path_tally = tally == "path";
+      }
+      else if (option == "--visits") { visits_filename = argv[++i]; }
+      else if (option == "--downsample") {
+        int value = std::stoi(argv[++i]);
+        if (value < 1) {
+          throw std::runtime_error("Downsample factor must be positive");
+        }
+        downsample = value;
+      }
+      else if (option == "--print") { num_print = std::stoull(argv[++i]); }
+      else { throw std::runtime_error("Unknown option "+option); }
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  try {
+    util::TrajectoryReader reader(argv[1]);
+    const util::TrajectoryHeader & header = reader.header();
+    std::cout << "Read " << reader.num_histories() << " histories of ";
+    std::cout << reader.cases().size() << " cases from " << argv[1];
+    std::cout << (reader.is_mapped() ? " (memory mapped)" : "");
+    std::cout << "\n" << std::endl;
+
+    std::unique_ptr<util::NpyWriter> visits;
+    unsigned int map_x_dim = (header._x_dim + downsample - 1) / downsample;
+    unsigned int map_y_dim = (header._y_dim + downsample - 1) / downsample;
+    if (!visits_filename.empty()) {
+      visits = std::make_unique<util::NpyWriter>(
+        visits_filename, map_x_dim, map_y_dim);
+      if (!visits->is_open()) {
+        throw std::runtime_error("Failed to open "+visits_filename);
+      }
+    }
+
+    // Visits of the replayed histories of the current case, summed as
+    // integers and averaged per replayed history, matching gridwalk
+    std::vector<uint64_t> num_visits;
+    std::vector<float> map;
+    auto tally = [&](unsigned long long x, unsigned long long y) {
+      ++num_visits[(y/downsample)*map_x_dim + x/downsample];
+    };
+    const util::Coord goal(header._goal_x, header._goal_y);
+
+    std::cout << std::setw(8) << "case" << std::setw(12) << "histories";
+    std::cout << std::setw(16) << "mean steps" << std::setw(16) << "error";
+    std::cout << std::setw(12) << "replayed" << std::setw(16) << "mean";
+    std::cout << "\n";
+    unsigned long long num_printed = 0;
+    for (const util::TrajectoryCase & trajectory_case : reader.cases()) {
+      if (one_case && trajectory_case._case_idx != case_idx) { continue; }
+
+      // Moments of every history of the case are read from the index, only
+      // histories stopped at the max number of steps are replayed to check
+      // whether they were aborted
+      util::WalkMoments all, replayed;
+      auto ignore = [](const util::Coord &, util::direction, unsigned int) {};
+      for (uint64_t h = 0; h < trajectory_case._num_histories; h++) {
+        uint64_t i = trajectory_case._first_history+h;
+        all.add(reader.history(i)._num_moves);
+        if (reader.history(i)._num_moves >= header._max_steps &&
+            !(reader.replay(i, ignore) == goal)) {
+          all._aborted = 1;
+        }
+      }
+      if (visits) {
+        num_visits.assign(static_cast<size_t>(map_x_dim)*map_y_dim, 0);
+      }
+
+      uint64_t end = std::min<uint64_t>(
+        last_history, trajectory_case._num_histories);
+      for (uint64_t h = first_history; h < end; h++) {
+        uint64_t i = trajectory_case._first_history+h;
+        uint64_t steps = reader.history(i)._num_moves;
+        if (steps < min_steps || steps > max_steps) { continue; }
+        if (through) {
+          bool passes = header._start_x == through_x &&
+            header._start_y == through_y;
+          reader.replay(i, [&](const util::Coord & position,
+                               util::direction dir, unsigned int dist) {
+            for_path(position, dir, dist,
+                     [&](unsigned long long x, unsigned long long y) {
+              passes = passes || (x == through_x && y == through_y);
+            });
+          });
+          if (!passes) { continue; }
+        }
+
+        bool print = num_printed < num_print;
+        if (print) {
+          std::cout << "history " << i << " of case ";
+          std::cout << trajectory_case._case_idx << ":";
+          ++num_printed;
+        }
+        if (visits) { tally(header._start_x, header._start_y); }
+        util::Coord final_position = reader.replay(i,
+            [&](const util::Coord & position, util::direction dir,
+                unsigned int dist) {
+          if (print) { std::cout << " " << dir << "/" << dist; }
+          if (!visits) { return; }
+          if (path_tally) { for_path(position, dir, dist, tally); }
+          else { tally(position._x_coord, position._y_coord); }
+        });
+        if (print) { std::cout << std::endl; }
+        replayed.add(steps);
+        if (!(final_position == goal)) { replayed._aborted = 1; }
+      }
+
+      std::cout << std::setw(8) << trajectory_case._case_idx;
+      std::cout << std::setw(12) << all._histories;
+      std::cout << std::setw(16) << std::setprecision(8);
+      std::cout << all.mean(header._max_steps);
+      std::cout << std::setw(16) << std::sqrt(all.mean_variance());
+      std::cout << std::setw(12) << replayed._histories;
+      std::cout << std::setw(16) << replayed.mean(header._max_steps) << "\n";
+
+      if (visits) {
+        map.assign(num_visits.size(), 0.0f);
+        for (size_t n = 0; n < map.size(); n++) {
+          map[n] = replayed._histories > 0 ?
+            static_cast<double>(num_visits[n]) / replayed._histories : 0.0;
+        }
+        visits->write(map);
+      }
+    }
+    std::cout << std::flush;
+    if (visits) {
+      visits->close();
+      std::cout << "Wrote spatial distributions to " << visits_filename;
+      std::cout << std::endl;
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
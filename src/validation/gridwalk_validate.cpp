@@ -0,0 +1,595 @@
+// Statistical validation of the accelerated walk engines against the
+// reference analog walk of MCWalk. Accelerated engines draw different random
+// numbers so their results never match bit for bit; instead each engine must
+// agree with the reference within the statistical error of both.
+// Output is one "kind name metric value [status]" line per measurement, and
+// the exit code is 1 if any check fails
+#include "mc_walk.hpp"
+#include "util/grid.hpp"
+#include "util/grid_generator.hpp"
+#include "util/likelihood_ratio.hpp"
+#include "util/walk_moments.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef GRIDWALK_EXAMPLES_DIR
+#define GRIDWALK_EXAMPLES_DIR "examples"
+#endif
+
+// Validation settings
+struct ValidateSettings {
+  // Number of histories per walk
+  double _num_samples = 10000;
+  // Number of batches the histories of tallied walks are split into to
+  // estimate the variance of the visits of each node
+  unsigned int _num_batches = 32;
+  // Probability of any check failing when every engine is unbiased, split
+  // evenly across the checks
+  double _alpha = 0.01;
+  // Only checks whose names contain this string are run
+  std::string _filter;
+  // Directory holding the example grids
+  std::string _examples_dir = GRIDWALK_EXAMPLES_DIR;
+};
+
+// Seed of the engines compared to the reference, which uses the default
+// seed, so the compared histories are independent
+static const double validation_seed = 27182818;
+
+// Named grid and PMF walked by every engine
+struct ValidationCase {
+  std::string _name;
+  Grid * _grid;
+  std::vector<double> _params;
+};
+
+// Result of walking a case with an engine
+struct EngineRun {
+  double _mean = 0;
+  double _error = 0;
+  // Degrees of freedom of the error, the number of independent groups the
+  // variance is estimated from less one
+  double _dof = 0;
+  double _seconds = 0;
+};
+
+// Visits per history of each cell of downsample x downsample nodes, one
+// vector per batch of histories
+using VisitBatches = std::vector<std::vector<double>>;
+
+// Batches hold a multiple of this many histories so the antithetic pairs and
+// the 16 Sobol randomizations of the compared engines divide every batch
+static const unsigned int batch_multiple = 32;
+
+// Engine compared to the reference. walk returns the results of a walk of
+// num_samples histories, visits is null for engines whose visit maps are
+// those of the reference by construction or that tally no visits.
+struct Engine {
+  std::string _name;
+  std::function<EngineRun(const ValidationCase &, double)> _walk;
+  std::function<VisitBatches(const ValidationCase &, double, unsigned int)>
+    _visits;
+};
+
+// Returns x such that a standard normal variable exceeds x with
+// probability p, by bisection of the complementary error function
+static double normal_quantile(double p) {
+  double low = -40, high = 40;
+  for (int i = 0; i < 200; i++) {
+    double mid = 0.5*(low + high);
+    if (0.5*std::erfc(mid/std::sqrt(2.0)) > p) { low = mid; }
+    else { high = mid; }
+  }
+  return 0.5*(low + high);
+}
+
+// Continued fraction of the regularized incomplete beta function, evaluated
+// with the modified Lentz method
+static double beta_fraction(double a, double b, double x) {
+  const double tiny = 1e-300;
+  double c = 1.0;
+  double d = 1.0 - (a+b)*x/(a+1);
+  d = 1.0/(std::abs(d) < tiny ? tiny : d);
+  double fraction = d;
+  for (int m = 1; m <= 1000; m++) {
+    for (int step = 0; step < 2; step++) {
+      double numerator = step == 0 ?
+        m*(b-m)*x/((a+2*m-1)*(a+2*m)) :
+        -(a+m)*(a+b+m)*x/((a+2*m)*(a+2*m+1));
+      d = 1.0 + numerator*d;
+      d = 1.0/(std::abs(d) < tiny ? tiny : d);
+      c = 1.0 + numerator/c;
+      if (std::abs(c) < tiny) { c = tiny; }
+      fraction *= c*d;
+      if (step == 1 && std::abs(c*d - 1.0) < 1e-15) { return fraction; }
+    }
+  }
+  return fraction;
+}
+
+// Returns the regularized incomplete beta function I_x(a, b), the CDF at x
+// of a Beta(a, b) variable
+static double incomplete_beta(double a, double b, double x) {
+  if (x <= 0) { return 0; }
+  if (x >= 1) { return 1; }
+  double front = std::exp(std::lgamma(a+b) - std::lgamma(a) - std::lgamma(b) +
+                          a*std::log(x) + b*std::log(1-x));
+  if (x < (a+1)/(a+b+2)) { return front*beta_fraction(a, b, x)/a; }
+  return 1.0 - front*beta_fraction(b, a, 1-x)/b;
+}
+
+// Walks the case with an MCWalk set up by configure and seeded with seed,
+// whose error is estimated from error_groups independent groups of
+// histories, or one group per history if 0
+static EngineRun walk_mc(
+    const ValidationCase & validation_case, double num_samples, double seed,
+    const std::function<void(MCWalk &)> & configure,
+    unsigned int error_groups = 0) {
+  MCWalk walk(validation_case._grid);
+  walk.set_verbose(false);
+  walk.set_seed(seed);
+  configure(walk);
+  walk.reset();
+  walk.set_biased_PMF(validation_case._params);
+  auto start = std::chrono::steady_clock::now();
+  walk.walk_grid(num_samples);
+  EngineRun run;
+  run._seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  run._mean = walk.get_mean();
+  run._error = walk.get_error();
+  run._dof = (error_groups > 0 ? error_groups : num_samples) - 1;
+  return run;
+}
+
+// Returns the most cells whose visits are compared for num_batches batches,
+// few enough that their covariance is well estimated
+static unsigned int max_cells(unsigned int num_batches) {
+  return std::min(16u, num_batches/2);
+}
+
+// Returns the number of nodes per side of the cells visits are summed over,
+// the smallest that leaves at most max_cells cells
+static unsigned int cell_size(const Grid & grid, unsigned int max_cells) {
+  unsigned int size = 1;
+  while (static_cast<unsigned long long>(
+           (grid.get_x_dim()+size-1)/size)*
+         ((grid.get_y_dim()+size-1)/size) > max_cells) {
+    ++size;
+  }
+  return size;
+}
+
+// Walks the case num_batches times with a tracked MCWalk and returns the
+// visits per history of each cell of every batch
+static VisitBatches visits_mc(
+    const ValidationCase & validation_case, double num_samples,
+    unsigned int num_batches, double seed,
+    const std::function<void(MCWalk &)> & configure) {
+  Grid * grid = validation_case._grid;
+  MCWalk walk(grid, true);
+  walk.set_verbose(false);
+  walk.set_seed(seed);
+  configure(walk);
+  walk.reset();
+  walk.set_biased_PMF(validation_case._params);
+  const double batch_samples = batch_multiple*
+    std::floor(num_samples/num_batches/batch_multiple);
+  const unsigned int size = cell_size(*grid, max_cells(num_batches));
+  VisitBatches batches;
+  for (unsigned int b = 0; b < num_batches; b++) {
+    grid->clear_visits();
+    walk.walk_grid(batch_samples);
+    std::vector<float> map;
+    grid->get_visit_map(map, batch_samples, size);
+    batches.emplace_back(map.begin(), map.end());
+  }
+  grid->clear_visits();
+  return batches;
+}
+
+// Walks the case in num_shards shards with walk_shard and merges their
+// moments, as gridwalk --shard and gridwalk_merge do
+static EngineRun walk_shards(
+    const ValidationCase & validation_case, double num_samples,
+    unsigned int num_shards) {
+  MCWalk walk(validation_case._grid);
+  walk.set_verbose(false);
+  walk.set_seed(validation_seed);
+  walk.reset();
+  walk.set_biased_PMF(validation_case._params);
+  util::WalkMoments moments;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int shard = 0; shard < num_shards; shard++) {
+    moments.merge(walk.walk_shard(num_samples, shard, num_shards));
+  }
+  EngineRun run;
+  run._seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  run._mean = moments.mean(walk.get_max_steps());
+  run._error = std::sqrt(moments.mean_variance());
+  run._dof = num_samples-1;
+  return run;
+}
+
+// Walks the case with a reference PMF that mixes a little of the uniform
+// direction PMF into that of the case and slightly lengthens its distances,
+// and estimates the case by reweighting the reference histories, as Reweight
+// does for clusters of entries. The reference stays close to the case so
+// the weights of long histories do not degenerate.
+static EngineRun walk_reweighted(
+    const ValidationCase & validation_case, double num_samples) {
+  const std::vector<double> & params = validation_case._params;
+  const double total = std::accumulate(params.begin(), params.end()-1, 0.0);
+  std::vector<double> reference(params.size());
+  for (size_t d = 0; d+1 < params.size(); d++) {
+    reference[d] = 0.98*params[d]/total + 0.02/(params.size()-1);
+  }
+  reference.back() = 1.02*params.back();
+  Grid * grid = validation_case._grid;
+  util::LikelihoodRatios ratios(
+    reference, std::max(grid->get_x_dim(), grid->get_y_dim()));
+  ratios.add_target(params);
+  MCWalk walk(grid);
+  walk.set_verbose(false);
+  walk.set_seed(validation_seed);
+  walk.reset();
+  walk.set_biased_PMF(reference);
+  auto start = std::chrono::steady_clock::now();
+  if (!walk.walk_reweighted(num_samples, ratios)) {
+    throw std::runtime_error(
+      "Reference walk of "+validation_case._name+" exceeded the max steps");
+  }
+  EngineRun run;
+  run._seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  run._mean = ratios.mean(0);
+  run._error = ratios.error(0);
+  run._dof = num_samples-1;
+  return run;
+}
+
+// Returns the engines compared to the reference
+static std::vector<Engine> engines() {
+  using namespace std::placeholders;
+  auto mc_engine = [](const std::string & name, bool tallies,
+                      std::function<void(MCWalk &)> configure,
+                      unsigned int error_groups = 0) {
+    Engine engine;
+    engine._name = name;
+    engine._walk = std::bind(
+      walk_mc, _1, _2, validation_seed, configure, error_groups);
+    if (tallies) {
+      engine._visits = std::bind(
+        visits_mc, _1, _2, _3, validation_seed, configure);
+    }
+    return engine;
+  };
+  std::vector<Engine> compared;
+  // The reference with another seed checks the checks themselves
+  compared.push_back(mc_engine("reseeded", true, [](MCWalk &) {}));
+  // Tracked walks of the block engine walk exactly, so only its means are
+  // compared. Histories of the block engine share tables, so its error is
+  // the spread of its independent table groups.
+  compared.push_back(mc_engine("block", false, [](MCWalk & walk) {
+    walk.set_block_engine(8, 64);
+  }, MCWalk::table_groups));
+  compared.push_back(mc_engine("antithetic", true, [](MCWalk & walk) {
+    walk.set_sampling(util::sampling::antithetic_sampling);
+  }));
+  compared.push_back(mc_engine("sobol", true, [](MCWalk & walk) {
+    walk.set_sampling(util::sampling::sobol_sampling, 8, 16);
+  }, 16));
+  compared.push_back({"shards", std::bind(walk_shards, _1, _2, 4), nullptr});
+  // Visits of reweighted walks are those of the reference PMF
+  compared.push_back({"reweight", walk_reweighted, nullptr});
+  return compared;
+}
+
+// Counts the checks and failures and prints each check
+class CheckLog {
+private:
+  // Significance level of each check
+  double _check_alpha;
+  unsigned int _num_checks = 0;
+  unsigned int _num_failed = 0;
+
+  void report(const std::string & kind, const std::string & name,
+              const std::string & metric, double value, bool pass) {
+    std::cout << kind << " " << name << " " << metric << " ";
+    std::cout << std::fixed << std::setprecision(3) << value << " ";
+    std::cout << (pass ? "pass" : "FAIL") << "\n";
+    std::cout.flush();
+    ++_num_checks;
+    if (!pass) { ++_num_failed; }
+  }
+
+public:
+  // Split alpha evenly across num_checks checks
+  CheckLog(double alpha, unsigned int num_checks)
+    : _check_alpha(alpha/num_checks) {};
+
+  unsigned int num_checks() const { return _num_checks; }
+  unsigned int num_failed() const { return _num_failed; }
+
+  // Checks the means agree with a two sided Welch t-test on their errors,
+  // reported as the normal z of the same p-value
+  void check_mean(const std::string & name, const EngineRun & reference,
+                  const EngineRun & run) {
+    double reference_var = reference._error*reference._error;
+    double var = run._error*run._error;
+    double difference = run._mean - reference._mean;
+    if (reference_var + var <= 0) {
+      bool pass = difference == 0;
+      report("mean", name, "z", pass ? 0 : INFINITY, pass);
+      return;
+    }
+    double t = difference/std::sqrt(reference_var + var);
+    double dof = (reference_var + var)*(reference_var + var)/
+      (reference_var*reference_var/reference._dof + var*var/run._dof);
+    double p = incomplete_beta(0.5*dof, 0.5, dof/(dof + t*t));
+    double z = std::copysign(normal_quantile(std::max(0.5*p, 1e-300)), t);
+    report("mean", name, "z", z, p >= _check_alpha);
+  }
+
+  // Checks the visit maps agree with a two sample Hotelling T^2 test on the
+  // batch means of each cell, the chi-square test of the difference of the
+  // mean maps under the covariance of the cells estimated from the batches.
+  // Cells varying no more than a combination of the cells before them are
+  // left out, and must match exactly if they never vary.
+  void check_visits(const std::string & name, const VisitBatches & reference,
+                    const VisitBatches & batches) {
+    const size_t num_batches = batches.size();
+    const size_t num_cells = batches[0].size();
+    std::vector<double> difference(num_cells, 0.0);
+    std::vector<double> reference_mean(num_cells, 0.0);
+    std::vector<double> mean(num_cells, 0.0);
+    for (size_t b = 0; b < num_batches; b++) {
+      for (size_t i = 0; i < num_cells; i++) {
+        reference_mean[i] += reference[b][i]/num_batches;
+        mean[i] += batches[b][i]/num_batches;
+      }
+    }
+    // Pooled covariance of the batches of both walks
+    std::vector<double> covariance(num_cells*num_cells, 0.0);
+    for (const VisitBatches * walk : {&reference, &batches}) {
+      const std::vector<double> & walk_mean =
+        walk == &reference ? reference_mean : mean;
+      for (size_t b = 0; b < num_batches; b++) {
+        for (size_t i = 0; i < num_cells; i++) {
+          for (size_t j = 0; j < num_cells; j++) {
+            covariance[i*num_cells+j] +=
+              ((*walk)[b][i] - walk_mean[i])*((*walk)[b][j] - walk_mean[j])/
+              (2*num_batches - 2);
+          }
+        }
+      }
+    }
+    for (size_t i = 0; i < num_cells; i++) {
+      difference[i] = mean[i] - reference_mean[i];
+    }
+
+    // Cholesky factor of the covariance of the kept cells, row by row,
+    // and the solution of L y = difference, so T^2 = n/2 |y|^2
+    std::vector<size_t> kept;
+    std::vector<std::vector<double>> factor;
+    std::vector<double> solution;
+    double distance = 0;
+    bool exact_mismatch = false;
+    for (size_t i = 0; i < num_cells; i++) {
+      double variance = covariance[i*num_cells+i];
+      std::vector<double> row;
+      double pivot = variance;
+      for (size_t k = 0; k < kept.size(); k++) {
+        double value = covariance[i*num_cells+kept[k]];
+        for (size_t l = 0; l < k; l++) { value -= row[l]*factor[k][l]; }
+        value /= factor[k][k];
+        row.push_back(value);
+        pivot -= value*value;
+      }
+      if (variance <= 0) {
+        if (std::abs(difference[i]) > 1e-9) { exact_mismatch = true; }
+        continue;
+      }
+      if (pivot <= 1e-9*variance) { continue; }
+      row.push_back(std::sqrt(pivot));
+      // Forward substitution of the new row
+      double y = difference[i];
+      for (size_t k = 0; k < kept.size(); k++) { y -= row[k]*solution[k]; }
+      y /= row.back();
+      solution.push_back(y);
+      distance += y*y;
+      kept.push_back(i);
+      factor.push_back(row);
+    }
+
+    // T^2 scaled to an F(k, 2n-k-1) variable
+    const double k = kept.size();
+    const double dof = 2.0*num_batches - k - 1;
+    double p = 1;
+    if (exact_mismatch) {
+      p = 0;
+    }
+    else if (k > 0 && dof > 0) {
+      double t_square = 0.5*num_batches*distance;
+      double F = dof/((2.0*num_batches - 2)*k)*t_square;
+      p = incomplete_beta(0.5*dof, 0.5*k, dof/(dof + k*F));
+    }
+    report("visits", name, "hotelling_z",
+           normal_quantile(std::max(p, 1e-300)), p >= _check_alpha);
+  }
+};
+
+// Print a measurement that is not checked
+static void report_measurement(
+    const std::string & kind, const std::string & name,
+    const std::string & metric, double value) {
+  std::cout << kind << " " << name << " " << metric << " ";
+  std::cout << std::fixed << std::setprecision(3) << value << "\n";
+  std::cout.flush();
+}
+
+// Reads a grid from the examples directory
+static Grid read_example(
+    const ValidateSettings & settings, const std::string & filename) {
+  std::string path = settings._examples_dir+"/"+filename;
+  std::ifstream grid_input(path);
+  if (!grid_input.is_open()) {
+    throw std::runtime_error("Failed to open "+path);
+  }
+  return Grid(grid_input);
+}
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_validate [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --quick              fewer histories for smoke testing\n";
+  std::cout << "  --samples n          histories per walk (default 10000)\n";
+  std::cout << "  --batches n          batches of tallied walks (default ";
+  std::cout << "32)\n";
+  std::cout << "  --alpha a            probability of a false failure ";
+  std::cout << "(default 0.01)\n";
+  std::cout << "  --filter string      only run checks containing string\n";
+  std::cout << "  --examples dir       directory holding the example grids";
+  std::cout << std::endl;
+}
+
+int main(int argc, char* argv []) {
+  ValidateSettings settings;
+  for (int i = 1; i < argc; i++) {
+    std::string option(argv[i]);
+    if (option == "--quick") {
+      settings._num_samples = 2000;
+      settings._num_batches = 16;
+    }
+    else if (option == "--samples" && i+1 < argc) {
+      settings._num_samples = std::stod(argv[++i]);
+    }
+    else if (option == "--batches" && i+1 < argc) {
+      settings._num_batches = std::stoul(argv[++i]);
+    }
+    else if (option == "--alpha" && i+1 < argc) {
+      settings._alpha = std::stod(argv[++i]);
+    }
+    else if (option == "--filter" && i+1 < argc) {
+      settings._filter = argv[++i];
+    }
+    else if (option == "--examples" && i+1 < argc) {
+      settings._examples_dir = argv[++i];
+    }
+    else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  try {
+    if (settings._num_batches < 4 ||
+        settings._num_samples < batch_multiple*settings._num_batches) {
+      throw std::runtime_error(
+        "Validation needs at least 4 batches of "+
+        std::to_string(batch_multiple)+" histories");
+    }
+    // Grids small enough that every PMF reaches the goal well below the
+    // max number of steps
+    std::vector<std::pair<std::string, Grid>> grids;
+    for (const std::string name :
+         {"simple_square", "blocked_square", "hole_square", "tunnel"}) {
+      grids.emplace_back(name, read_example(settings, name+".txt"));
+    }
+    grids.emplace_back(
+      "open_16", util::generate_grid(util::open_field, 16, 16));
+    grids.emplace_back("maze_9", util::generate_grid(util::maze, 9, 9));
+    // Large enough for the block engine to jump across blocks far from the
+    // goal. The biased PMF pins walkers to its walls, where histories exceed
+    // the max number of steps, so it walks only the other PMFs.
+    const std::string large_grid = "open_48";
+    grids.emplace_back(
+      large_grid, util::generate_grid(util::open_field, 48, 48));
+    const std::vector<std::pair<std::string, std::vector<double>>> PMFs = {
+      {"analog", {0.125,0.125,0.125,0.125,0.125,0.125,0.125,0.125,1.0}},
+      {"long_steps", {0.125,0.125,0.125,0.125,0.125,0.125,0.125,0.125,0.4}},
+      {"biased", {0.05,0.1,0.2,0.2,0.2,0.1,0.1,0.05,1.5}}};
+
+    std::vector<ValidationCase> cases;
+    for (auto & grid : grids) {
+      for (const auto & PMF : PMFs) {
+        if (grid.first == large_grid && PMF.first == "biased") { continue; }
+        cases.push_back(
+          {grid.first+"/"+PMF.first, &grid.second, PMF.second});
+      }
+    }
+    std::vector<Engine> compared = engines();
+
+    // Count the checks that pass the filter to split alpha across them
+    auto selected = [&](const std::string & name) {
+      return name.find(settings._filter) != std::string::npos;
+    };
+    unsigned int num_checks = 0;
+    for (const auto & validation_case : cases) {
+      for (const auto & engine : compared) {
+        if (!selected(validation_case._name+"/"+engine._name)) { continue; }
+        num_checks += engine._visits ? 2 : 1;
+      }
+    }
+    if (num_checks == 0) {
+      throw std::runtime_error("No checks match "+settings._filter);
+    }
+    CheckLog log(settings._alpha, num_checks);
+
+    std::cout << "# kind name metric value [status]\n";
+    const auto no_options = [](MCWalk &) {};
+    for (const auto & validation_case : cases) {
+      EngineRun reference;
+      VisitBatches reference_visits;
+      bool walked = false, tallied = false;
+      for (const auto & engine : compared) {
+        std::string name = validation_case._name+"/"+engine._name;
+        if (!selected(name)) { continue; }
+        // Walk the reference only for cases with a selected check
+        if (!walked) {
+          reference = walk_mc(validation_case, settings._num_samples,
+                              Walker::default_seed, no_options);
+          report_measurement(
+            "throughput", validation_case._name+"/reference",
+            "histories_per_sec", settings._num_samples/reference._seconds);
+          walked = true;
+        }
+        EngineRun run = engine._walk(validation_case, settings._num_samples);
+        log.check_mean(name, reference, run);
+        report_measurement("throughput", name, "histories_per_sec",
+                           settings._num_samples/run._seconds);
+        report_measurement("throughput", name, "speedup",
+                           reference._seconds/run._seconds);
+        if (!engine._visits) { continue; }
+        if (!tallied) {
+          reference_visits = visits_mc(
+            validation_case, settings._num_samples, settings._num_batches,
+            Walker::default_seed, no_options);
+          tallied = true;
+        }
+        log.check_visits(name, reference_visits,
+          engine._visits(validation_case, settings._num_samples,
+                         settings._num_batches));
+      }
+    }
+    std::cout << "# " << log.num_failed() << " of " << log.num_checks();
+    std::cout << " checks failed" << std::endl;
+    return log.num_failed() > 0 ? 1 : 0;
+  }
+  catch (const std::runtime_error & e) {
+    std::cout << e.what() << std::endl;
+    return 2;
+  }
+}
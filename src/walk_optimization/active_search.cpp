@@ -0,0 +1,303 @@
+// Surrogate guided active search for the PMF parameters minimizing the mean
+// number of steps to the goal. Each round an ensemble of surrogate networks
+// scores a large batch of random candidates, the candidates with the lowest
+// predicted mean and the largest ensemble disagreement are walked with
+// MCWalk, and the ensemble is retrained on the new points.
+#include "surrogate_model.hpp"
+#include "mc_walk.hpp"
+#include "util/grid.hpp"
+#include "util/rand.hpp"
+#include "util/results_writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace mlpack;
+using namespace surrogate;
+
+/*
+ * Settings of the active search.
+ */
+struct SearchSettings
+{
+  //! Number of search rounds.
+  size_t rounds = 10;
+  //! Number of candidates scored by the surrogate per round.
+  size_t candidates = 100000;
+  //! Number of candidates walked with MCWalk per round, half chosen for the
+  //! lowest predicted mean and half for the largest disagreement.
+  size_t evaluations = 8;
+  //! Number of networks in the ensemble.
+  size_t ensembleSize = 4;
+  //! Number of passes over the data when training each round.
+  size_t epochs = 50;
+  //! Number of histories per MCWalk evaluation.
+  double samples = 1e4;
+  //! Range of the distance PMF parameter of the candidates.
+  double minLambda = 1.0;
+  double maxLambda = 3.0;
+  //! Seed of the candidate generator.
+  double seed = 16180339;
+};
+
+/*
+ * Fill the columns of candidates with random PMF parameters. Half are drawn
+ * uniformly from the simplex of direction probabilities, half are
+ * perturbations of the best parameters found so far.
+ */
+void SampleCandidates(util::RNG& rng,
+                      const SearchSettings& settings,
+                      const arma::vec& best,
+                      arma::mat& candidates)
+{
+  candidates.set_size(NumFeatures, settings.candidates);
+  for (size_t c = 0; c < candidates.n_cols; ++c)
+  {
+    double* column = candidates.colptr(c);
+    const bool local = (c % 2 == 1);
+    double total = 0;
+    for (size_t i = 0; i < NumFeatures - 1; ++i)
+    {
+      // Exponential samples normalize to a uniform point on the simplex
+      double value = -std::log(1.0 - rng.sample() * (1.0 - 1e-12));
+      if (local)
+        value = best(i) * std::exp(0.5 * (rng.sample() - 0.5));
+      column[i] = value;
+      total += value;
+    }
+    for (size_t i = 0; i < NumFeatures - 1; ++i)
+      column[i] /= total;
+
+    double lambda = settings.minLambda +
+        rng.sample() * (settings.maxLambda - settings.minLambda);
+    if (local)
+    {
+      lambda = std::min(settings.maxLambda, std::max(settings.minLambda,
+          best(NumFeatures - 1) + 0.5 * (rng.sample() - 0.5)));
+    }
+    column[NumFeatures - 1] = lambda;
+  }
+}
+
+/*
+ * Train every network of the ensemble on the current data, continuing from
+ * the parameters of the previous round.
+ */
+void TrainEnsemble(std::vector<std::unique_ptr<Model>>& ensemble,
+                   const arma::mat& features,
+                   const arma::mat& outputs,
+                   const SearchSettings& settings)
+{
+  for (auto& model : ensemble)
+  {
+    ens::Adam optimizer = MakeOptimizer(1e-3, 36,
+        settings.epochs * features.n_cols);
+    model->Train(features, outputs, optimizer);
+  }
+}
+
+/*
+ * Returns the ensemble mean and standard deviation of the prediction for
+ * each candidate.
+ */
+void ScoreCandidates(std::vector<std::unique_ptr<Model>>& ensemble,
+                     const arma::mat& candidates,
+                     arma::rowvec& mean,
+                     arma::rowvec& deviation)
+{
+  arma::mat predictions(ensemble.size(), candidates.n_cols);
+  arma::mat prediction;
+  for (size_t m = 0; m < ensemble.size(); ++m)
+  {
+    ensemble[m]->Predict(candidates, prediction);
+    predictions.row(m) = prediction.row(0);
+  }
+  mean = arma::mean(predictions, 0);
+  deviation = arma::stddev(predictions, 0, 0);
+}
+
+/*
+ * Returns the indices of the candidates to walk: the lowest predicted means
+ * followed by the largest deviations not already chosen.
+ */
+std::vector<arma::uword> SelectCandidates(const arma::rowvec& mean,
+                                          const arma::rowvec& deviation,
+                                          const size_t evaluations)
+{
+  const size_t numExploit = (evaluations + 1) / 2;
+  arma::uvec byMean = arma::sort_index(mean, "ascend");
+  arma::uvec byDeviation = arma::sort_index(deviation, "descend");
+  std::vector<arma::uword> selected;
+  for (size_t i = 0; i < byMean.n_elem && selected.size() < numExploit; ++i)
+    selected.push_back(byMean(i));
+  for (size_t i = 0; i < byDeviation.n_elem &&
+       selected.size() < evaluations; ++i)
+  {
+    if (std::find(selected.begin(), selected.end(), byDeviation(i)) ==
+        selected.end())
+      selected.push_back(byDeviation(i));
+  }
+  return selected;
+}
+
+/*
+ * Prints the command line usage.
+ */
+void PrintUsage()
+{
+  std::cout << "Usage: gridwalk_active grid_file initial_results_file "
+            << "[options]\n"
+            << "Options:\n"
+            << "  --rounds n        search rounds (default 10)\n"
+            << "  --candidates n    candidates scored per round "
+            << "(default 100000)\n"
+            << "  --evaluations n   candidates walked per round (default 8)\n"
+            << "  --ensemble n      networks in the ensemble (default 4)\n"
+            << "  --epochs n        training passes per round (default 50)\n"
+            << "  --samples n       histories per walk (default 10000)\n"
+            << "  --seed s          candidate generator seed\n"
+            << "  --output file     results of every walk (default "
+            << "active_search_results.csv)" << std::endl;
+}
+
+int main(int argc, char* argv [])
+{
+  if (argc < 3) {
+    PrintUsage();
+    return 1;
+  }
+  SearchSettings settings;
+  std::string outputFilename = "active_search_results.csv";
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::string option(argv[i]);
+    if (i + 1 >= argc)
+    {
+      PrintUsage();
+      return 1;
+    }
+    const std::string value(argv[++i]);
+    if (option == "--rounds")
+      settings.rounds = std::stoul(value);
+    else if (option == "--candidates")
+      settings.candidates = std::stoul(value);
+    else if (option == "--evaluations")
+      settings.evaluations = std::stoul(value);
+    else if (option == "--ensemble")
+      settings.ensembleSize = std::stoul(value);
+    else if (option == "--epochs")
+      settings.epochs = std::stoul(value);
+    else if (option == "--samples")
+      settings.samples = std::stod(value);
+    else if (option == "--seed")
+      settings.seed = std::stod(value);
+    else if (option == "--output")
+      outputFilename = value;
+    else
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  std::ifstream gridInput(argv[1], std::ios::in | std::ios::binary);
+  if (!gridInput.is_open())
+  {
+    std::cout << "Failed to open " << argv[1] << std::endl;
+    return 2;
+  }
+  Grid grid(gridInput);
+  gridInput.close();
+
+  arma::mat data;
+  if (!LoadResults(argv[2], data))
+  {
+    std::cout << "Error reading data file " << argv[2] << std::endl;
+    return 2;
+  }
+  arma::mat features, outputs;
+  SplitResults(data, features, outputs);
+
+  util::ResultsWriter results(outputFilename, util::results_format::csv);
+  if (!results.is_open())
+  {
+    std::cout << "Failed to open " << outputFilename << std::endl;
+    return 2;
+  }
+
+  // Best parameters seen so far, walked or from the initial data
+  arma::uword bestIdx = outputs.index_min();
+  arma::vec best = features.col(bestIdx);
+  double bestMean = outputs(bestIdx);
+
+  std::vector<std::unique_ptr<Model>> ensemble;
+  for (size_t m = 0; m < settings.ensembleSize; ++m)
+  {
+    ensemble.emplace_back(new Model());
+    BuildModel(*ensemble.back());
+  }
+
+  util::RNG rng(settings.seed);
+  MCWalk walk(&grid);
+  size_t numWalks = 0;
+  arma::mat candidates;
+  arma::rowvec mean, deviation;
+  for (size_t round = 0; round < settings.rounds; ++round)
+  {
+    TrainEnsemble(ensemble, features, outputs, settings);
+    SampleCandidates(rng, settings, best, candidates);
+    ScoreCandidates(ensemble, candidates, mean, deviation);
+
+    // Walk the selected candidates and add them to the training data
+    std::vector<arma::uword> selected =
+        SelectCandidates(mean, deviation, settings.evaluations);
+    for (const arma::uword c : selected)
+    {
+      std::vector<double> params(candidates.colptr(c),
+          candidates.colptr(c) + NumFeatures);
+      walk.reset();
+      walk.set_biased_PMF(params);
+      auto start = std::chrono::steady_clock::now();
+      const double walkMean = walk.walk_grid(settings.samples);
+      const double runtime = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      ++numWalks;
+
+      util::CaseResult result;
+      std::copy(params.begin(), params.end(), result._params);
+      result._mean = walkMean;
+      result._error = walk.get_error();
+      result._samples = settings.samples;
+      result._runtime = runtime;
+      results.write(result);
+
+      features.insert_cols(features.n_cols, candidates.col(c));
+      outputs.resize(1, outputs.n_cols + 1);
+      outputs(0, outputs.n_cols - 1) = walkMean;
+      if (walkMean < bestMean)
+      {
+        bestMean = walkMean;
+        best = candidates.col(c);
+      }
+    }
+
+    std::cout << "Round " << round << ": predicted best "
+              << mean.min() << ", walked best " << bestMean << " after "
+              << numWalks << " walks" << std::endl;
+  }
+
+  std::cout << "Best PMF parameters found:";
+  for (size_t i = 0; i < NumFeatures; ++i)
+    std::cout << " " << best(i);
+  std::cout << "\nMean number of steps: " << bestMean << std::endl;
+  std::cout << "Monte Carlo walks performed: " << numWalks << std::endl;
+
+  return 0;
+}
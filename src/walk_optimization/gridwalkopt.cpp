@@ -1,143 +1,605 @@
 // Adopted from example given at
 // https://github.com/mlpack/examples/blob/master/neural_network_regression/nn_regression.cpp
-// Compile with:
-// g++ -std=c++11 -Wa,-mbig-obj -O2 -o optimize gridwalkopt.cpp `pkg-config --libs mlpack armadillo` -fopenmp
-#include <mlpack/prereqs.hpp>
-#include <mlpack/core.hpp>
-#include <mlpack/methods/ann/loss_functions/mean_squared_error.hpp>
-#include <mlpack/core/data/scaler_methods/min_max_scaler.hpp>
-#include <mlpack/methods/ann/layer/layer.hpp>
-#include <mlpack/core/data/split_data.hpp>
-#include <mlpack/methods/ann/ffn.hpp>
-#include <mlpack/methods/ann/init_rules/he_init.hpp>
-#include <ensmallen.hpp>
+// Built by CMake as gridwalkopt when mlpack is found, linking gridwalk_core
+// for the results reader, scalers, and model export
+#include "surrogate_model.hpp"
+#include "util/worker_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace mlpack;
 using namespace mlpack::ann;
 using namespace ens;
+using namespace surrogate;
+
+/*
+ * Settings of the streaming training.
+ */
+struct TrainSettings
+{
+  //! Number of cases read from the training file at a time.
+  size_t batchCases = 1 << 20;
+  //! Number of passes over the training file.
+  size_t epochs = 20;
+  //! Scaling of the PMF parameters and of the mean number of steps.
+  util::scaling scaling = util::min_max_scaling;
+};
+
+/*
+ * One configuration of the network and optimizer trained by a sweep.
+ */
+struct SweepConfig
+{
+  //! Number of neurons of the three hidden layers.
+  std::array<size_t, 3> widths = {{ H1, H2, H3 }};
+  //! Step size of the Adam optimizer.
+  double stepSize = 1e-3;
+  //! Number of cases per Adam step.
+  size_t batchSize = 36;
+};
+
+/*
+ * Settings of a sweep over every combination of the listed widths, step
+ * sizes, and batch sizes.
+ */
+struct SweepSettings
+{
+  //! Number of configurations trained at once, 0 trains a single model.
+  size_t jobs = 0;
+  //! Threads of each configuration, 0 splits the hardware threads evenly.
+  size_t threads = 0;
+  std::vector<std::array<size_t, 3>> widths = {{{ H1, H2, H3 }}};
+  std::vector<double> stepSizes = { 1e-3 };
+  std::vector<size_t> batchSizes = { 36 };
+  //! Every holdout-th training case is held out for validation.
+  size_t holdout = 5;
+  //! Epochs without a lower validation MSE before a configuration stops.
+  size_t patience = 3;
+};
+
+/*
+ * Outcome of training one configuration of a sweep.
+ */
+struct SweepResult
+{
+  SweepConfig config;
+  //! Lowest validation MSE, in steps squared, and the epochs trained.
+  double validationMSE = std::numeric_limits<double>::infinity();
+  size_t epochs = 0;
+  //! Wall clock training time in seconds.
+  double seconds = 0;
+};
+
+/*
+ * Fit the feature and output scalers with one streaming pass over a results
+ * file.
+ */
+void FitScalers(util::ResultsReader& reader,
+                const TrainSettings& settings,
+                util::Scaler& featureScaler,
+                util::Scaler& outputScaler)
+{
+  std::vector<double> batch;
+  size_t numRead;
+  while ((numRead = reader.read_batch(settings.batchCases, batch)) > 0)
+  {
+    featureScaler.fit_batch(batch.data(), numRead, reader.num_columns());
+    outputScaler.fit_batch(batch.data(), numRead, reader.num_columns(),
+                           NumFeatures);
+  }
+  featureScaler.finalize();
+  outputScaler.finalize();
+  reader.rewind();
+}
+
+/*
+ * Read the next batch of a results file split into scaled features and
+ * outputs. Returns the number of cases read, 0 at the end of the file.
+ */
+size_t ReadScaledBatch(util::ResultsReader& reader,
+                       const TrainSettings& settings,
+                       const util::Scaler& featureScaler,
+                       const util::Scaler& outputScaler,
+                       arma::mat& features,
+                       arma::mat& outputs)
+{
+  arma::mat data;
+  const size_t numRead = ReadBatch(reader, settings.batchCases, data);
+  featureScaler.transform(data.memptr(), data.n_cols, data.n_rows);
+  outputScaler.transform(data.memptr(), data.n_cols, data.n_rows,
+                         NumFeatures);
+  SplitResults(data, features, outputs);
+  return numRead;
+}
+
+/*
+ * Train a model for the configured number of passes over a results file
+ * read batch by batch.
+ */
+void TrainStreaming(Model& model,
+                    util::ResultsReader& reader,
+                    const TrainSettings& settings,
+                    const util::Scaler& featureScaler,
+                    const util::Scaler& outputScaler)
+{
+  // Set parameters for the Adam optimizer, one pass over each batch per
+  // call to Train. The optimizer state is kept across batches.
+  ens::Adam optimizer = MakeOptimizer(1e-3, 36, settings.batchCases);
+  arma::mat features, outputs;
+  for (size_t epoch = 0; epoch < settings.epochs; ++epoch)
+  {
+    double loss = 0;
+    size_t numBatches = 0;
+    while (ReadScaledBatch(reader, settings, featureScaler, outputScaler,
+                           features, outputs) > 0)
+    {
+      optimizer.MaxIterations() = features.n_cols;
+      loss += model.Train(features, outputs, optimizer);
+      optimizer.ResetPolicy() = false;
+      ++numBatches;
+    }
+    reader.rewind();
+    std::cout << "Epoch " << epoch + 1 << " loss "
+              << loss / std::max<size_t>(1, numBatches) << std::endl;
+  }
+}
+
+/*
+ * Split a comma separated list, converting each item.
+ */
+template<typename T, typename Convert>
+std::vector<T> ParseList(const std::string& list, Convert convert)
+{
+  std::vector<T> values;
+  std::stringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ','))
+    values.push_back(convert(item));
+  if (values.empty())
+    throw std::runtime_error("Empty list " + list);
+  return values;
+}
+
+/*
+ * Parse hidden layer widths written as h1xh2xh3.
+ */
+std::array<size_t, 3> ParseWidths(const std::string& item)
+{
+  std::array<size_t, 3> widths;
+  std::stringstream layers(item);
+  std::string layer;
+  for (size_t& width : widths)
+  {
+    if (!std::getline(layers, layer, 'x') || (width = std::stoul(layer)) == 0)
+      throw std::runtime_error("Widths must be h1xh2xh3, got " + item);
+  }
+  return widths;
+}
 
 /*
- * Function to calculate MSE for arma::cube.
+ * Parse an Adam step size, which must be positive.
  */
-double MSE(arma::mat& pred, arma::mat& Y)
+double ParseRate(const std::string& item)
 {
-  return metric::SquaredEuclideanDistance::Evaluate(pred, Y) / (Y.n_elem);
+  const double rate = std::stod(item);
+  if (!(rate > 0))
+    throw std::runtime_error("Rates must be positive, got " + item);
+  return rate;
+}
+
+/*
+ * Parse a number of cases per Adam step, which must be positive.
+ */
+size_t ParseBatchSize(const std::string& item)
+{
+  const size_t batchSize = std::stoul(item);
+  if (batchSize == 0)
+    throw std::runtime_error("Batch sizes must be positive, got " + item);
+  return batchSize;
+}
+
+/*
+ * Read a whole results file split into scaled features and outputs, every
+ * holdout-th case into the validation set and the rest into the training
+ * set.
+ */
+void ReadSplit(util::ResultsReader& reader,
+               const TrainSettings& settings,
+               const util::Scaler& featureScaler,
+               const util::Scaler& outputScaler,
+               const size_t holdout,
+               arma::mat& trainFeatures,
+               arma::mat& trainOutputs,
+               arma::mat& validFeatures,
+               arma::mat& validOutputs)
+{
+  arma::mat features, outputs;
+  std::vector<arma::uword> train, valid;
+  size_t numCases = 0;
+  while (ReadScaledBatch(reader, settings, featureScaler, outputScaler,
+                         features, outputs) > 0)
+  {
+    train.clear();
+    valid.clear();
+    for (arma::uword c = 0; c < features.n_cols; ++c, ++numCases)
+      (numCases % holdout == 0 ? valid : train).push_back(c);
+    const arma::uvec trainCols(train), validCols(valid);
+    trainFeatures = arma::join_rows(trainFeatures, features.cols(trainCols));
+    trainOutputs = arma::join_rows(trainOutputs, outputs.cols(trainCols));
+    validFeatures = arma::join_rows(validFeatures, features.cols(validCols));
+    validOutputs = arma::join_rows(validOutputs, outputs.cols(validCols));
+  }
+  reader.rewind();
+}
+
+/*
+ * MSE of the predictions of a model in the original units of the outputs.
+ */
+double ScaledMSE(Model& model,
+                 const arma::mat& features,
+                 const arma::mat& outputs,
+                 const util::Scaler& outputScaler)
+{
+  arma::mat predictions;
+  model.Predict(features, predictions);
+  arma::mat expected = outputs;
+  outputScaler.inverse_transform(predictions.memptr(), predictions.n_elem, 1);
+  outputScaler.inverse_transform(expected.memptr(), expected.n_elem, 1);
+  return MSE(predictions, expected);
+}
+
+/*
+ * Train one configuration of a sweep on the in memory training set, one
+ * pass per epoch, until the validation MSE has not improved for patience
+ * epochs. The model is left with the parameters of its best epoch.
+ */
+SweepResult TrainConfig(Model& model,
+                        const SweepConfig& config,
+                        const SweepSettings& sweep,
+                        const size_t maxEpochs,
+                        const arma::mat& trainFeatures,
+                        const arma::mat& trainOutputs,
+                        const arma::mat& validFeatures,
+                        const arma::mat& validOutputs,
+                        const util::Scaler& outputScaler)
+{
+  const auto start = std::chrono::steady_clock::now();
+  SweepResult result;
+  result.config = config;
+  BuildModel(model, config.widths[0], config.widths[1], config.widths[2]);
+  ens::Adam optimizer = MakeOptimizer(config.stepSize, config.batchSize,
+                                      trainFeatures.n_cols);
+  arma::mat bestParameters;
+  size_t sinceBest = 0;
+  for (size_t epoch = 0; epoch < maxEpochs && sinceBest < sweep.patience;
+       ++epoch)
+  {
+    model.Train(trainFeatures, trainOutputs, optimizer);
+    optimizer.ResetPolicy() = false;
+    const double validationMSE = ScaledMSE(model, validFeatures,
+                                           validOutputs, outputScaler);
+    ++result.epochs;
+    if (validationMSE < result.validationMSE)
+    {
+      result.validationMSE = validationMSE;
+      bestParameters = model.Parameters();
+      sinceBest = 0;
+    }
+    else
+    {
+      ++sinceBest;
+    }
+  }
+  if (!bestParameters.is_empty())
+    model.Parameters() = bestParameters;
+  result.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+/*
+ * Train every configuration of the sweep, jobs at a time, and return the
+ * model with the lowest validation MSE. The results of every configuration
+ * are printed and written to sweep_results.csv.
+ */
+std::unique_ptr<Model> RunSweep(util::ResultsReader& reader,
+                                const TrainSettings& settings,
+                                const SweepSettings& sweep,
+                                const util::Scaler& featureScaler,
+                                const util::Scaler& outputScaler,
+                                SweepConfig& bestConfig)
+{
+  // The training set is shared read only by every configuration, so it is
+  // read once rather than streamed by each
+  arma::mat trainFeatures, trainOutputs, validFeatures, validOutputs;
+  ReadSplit(reader, settings, featureScaler, outputScaler, sweep.holdout,
+            trainFeatures, trainOutputs, validFeatures, validOutputs);
+  if (trainFeatures.n_cols == 0 || validFeatures.n_cols == 0)
+    throw std::runtime_error("Too few training cases to hold out");
+
+  std::vector<SweepConfig> configs;
+  for (const auto& widths : sweep.widths)
+    for (const double stepSize : sweep.stepSizes)
+      for (const size_t batchSize : sweep.batchSizes)
+        configs.push_back({ widths, stepSize, batchSize });
+  const size_t threads = (sweep.threads > 0) ? sweep.threads :
+      std::max<size_t>(1, std::thread::hardware_concurrency() / sweep.jobs);
+  std::cout << "Sweeping " << configs.size() << " configurations, "
+            << sweep.jobs << " at a time with " << threads
+            << " threads each, on " << trainFeatures.n_cols
+            << " training and " << validFeatures.n_cols
+            << " validation cases" << std::endl;
+
+  std::vector<SweepResult> results;
+  std::unique_ptr<Model> bestModel;
+  double bestMSE = std::numeric_limits<double>::infinity();
+  std::mutex mutex;
+  {
+    util::WorkerPool pool(sweep.jobs);
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+      pool.submit([&, i]() {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        // Each configuration starts from its own reproducible weights
+        arma::arma_rng::set_seed(16180339 + i);
+        // An exception escaping a job would terminate the whole sweep, so a
+        // configuration that fails to train is recorded with an infinite MSE
+        SweepResult result;
+        result.config = configs[i];
+        std::unique_ptr<Model> model;
+        std::string error;
+        try
+        {
+          model = std::make_unique<Model>();
+          result = TrainConfig(*model, configs[i], sweep, settings.epochs,
+              trainFeatures, trainOutputs, validFeatures, validOutputs,
+              outputScaler);
+        }
+        catch (const std::exception& e)
+        {
+          error = e.what();
+        }
+        catch (...)
+        {
+          error = "unknown error";
+        }
+        if (!error.empty())
+        {
+          model.reset();
+          result.validationMSE = std::numeric_limits<double>::infinity();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto& widths = result.config.widths;
+        std::cout << "Configuration " << widths[0] << "x" << widths[1] << "x"
+                  << widths[2] << " step " << result.config.stepSize
+                  << " batch " << result.config.batchSize << ": ";
+        if (!error.empty())
+          std::cout << "failed, " << error << std::endl;
+        else
+          std::cout << "validation MSE " << result.validationMSE << " after "
+                    << result.epochs << " epochs in " << result.seconds
+                    << " sec" << std::endl;
+        results.push_back(result);
+        if (model && result.validationMSE < bestMSE)
+        {
+          bestMSE = result.validationMSE;
+          bestModel = std::move(model);
+          bestConfig = result.config;
+        }
+      });
+    }
+    pool.wait();
+  }
+  if (!bestModel)
+    throw std::runtime_error("No configuration reached a finite MSE");
+
+  std::sort(results.begin(), results.end(),
+      [](const SweepResult& a, const SweepResult& b) {
+        return a.validationMSE < b.validationMSE;
+      });
+  std::ofstream report("sweep_results.csv");
+  report << "h1,h2,h3,step_size,batch_size,epochs,validation_mse,seconds\n";
+  report << std::setprecision(10);
+  for (const SweepResult& result : results)
+  {
+    report << result.config.widths[0] << "," << result.config.widths[1]
+           << "," << result.config.widths[2] << ","
+           << result.config.stepSize << "," << result.config.batchSize << ","
+           << result.epochs << "," << result.validationMSE << ","
+           << result.seconds << "\n";
+  }
+  std::cout << "Wrote the results of every configuration to "
+            << "sweep_results.csv" << std::endl;
+  return bestModel;
+}
+
+/*
+ * Prints the command line usage.
+ */
+void PrintUsage()
+{
+  std::cout << "Usage: gridwalkopt training_results_file "
+            << "testing_results_file [options]\n"
+            << "Options:\n"
+            << "  --scaling none|minmax|standard  feature and output scaling "
+            << "(default minmax)\n"
+            << "  --batch n    cases read from disk at a time (default "
+            << "1048576)\n"
+            << "  --epochs n   passes over the training file (default 20), "
+            << "the most per configuration of a sweep\n"
+            << "Sweep options, the training file is read into memory:\n"
+            << "  --sweep n          train every combination of the lists "
+            << "below, n at a time\n"
+            << "  --widths list      hidden layer widths h1xh2xh3,... "
+            << "(default 64x128x64)\n"
+            << "  --rates list       Adam step sizes (default 0.001)\n"
+            << "  --batch-sizes list cases per Adam step (default 36)\n"
+            << "  --threads n        threads of each configuration (default "
+            << "hardware threads / n)\n"
+            << "  --holdout k        hold out every k-th training case for "
+            << "validation (default 5)\n"
+            << "  --patience n       epochs without improvement before "
+            << "stopping (default 3)" << std::endl;
 }
 
 int main(int argc, char* argv [])
 {
-  if (argc != 3) {
-    std::cout << "Must pass training and testing data files" << std::endl;
+  if (argc < 3 || argc % 2 == 0) {
+    PrintUsage();
     return 1;
   }
-
-  // In Armadillo rows represent features, columns represent data points.
-  // Input is tranposed upon reading
-  arma::mat training_data;
-  arma::mat testing_data;
-
-  std::cout << "Reading training grid walk parameters and results from ";
-  std::cout << argv[1] << std::endl;
-  bool loadedDataset = data::Load(std::string(argv[1]), training_data, true, true, arma::csv_ascii);
-  // If dataset is not loaded correctly, exit.
-  if (!loadedDataset) {
-    std::cout << "Error reading data file" << argv[1] << std::endl;
-    return 2;
+  TrainSettings settings;
+  SweepSettings sweep;
+  try {
+    for (int i = 3; i < argc; i += 2)
+    {
+      const std::string option(argv[i]);
+      if (option == "--scaling")
+        settings.scaling = util::to_scaling(argv[i + 1]);
+      else if (option == "--batch")
+        settings.batchCases = std::stoul(argv[i + 1]);
+      else if (option == "--epochs")
+        settings.epochs = std::stoul(argv[i + 1]);
+      else if (option == "--sweep")
+        sweep.jobs = std::stoul(argv[i + 1]);
+      else if (option == "--widths")
+        sweep.widths = ParseList<std::array<size_t, 3>>(argv[i + 1],
+                                                       ParseWidths);
+      else if (option == "--rates")
+        sweep.stepSizes = ParseList<double>(argv[i + 1], ParseRate);
+      else if (option == "--batch-sizes")
+        sweep.batchSizes = ParseList<size_t>(argv[i + 1], ParseBatchSize);
+      else if (option == "--threads")
+        sweep.threads = std::stoul(argv[i + 1]);
+      else if (option == "--holdout")
+        sweep.holdout = std::stoul(argv[i + 1]);
+      else if (option == "--patience")
+        sweep.patience = std::stoul(argv[i + 1]);
+      else
+        throw std::runtime_error("Unknown option " + option);
+    }
+    if (sweep.holdout < 2)
+      throw std::runtime_error("Holdout must be at least 2");
   }
-  std::cout << "Reading testing grid walk parameters and results from ";
-  std::cout << argv[2] << std::endl;
-  loadedDataset = data::Load(std::string(argv[2]), testing_data, true, true, arma::csv_ascii);
-  // If dataset is not loaded correctly, exit.
-  if (!loadedDataset) {
-    std::cout << "Error reading data file" << argv[2] << std::endl;
-    return 2;
+  catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    PrintUsage();
+    return 1;
   }
 
-  // The train and valid datasets contain both - the features as well as the
-  // prediction. Split these into separate matrices.
-  arma::mat training_outputs = training_data.row(training_data.n_rows - 1);
-  arma::mat testing_outputs = testing_data.row(testing_data.n_rows - 1);
-  training_data.shed_row(training_data.n_rows - 1);
-  testing_data.shed_row(testing_data.n_rows - 1);
-  
-  //! - H1: The number of neurons in the 1st layer.
-  constexpr int H1 = 64;
-  //! - H2: The number of neurons in the 2nd layer.
-  constexpr int H2 = 128;
-  //! - H3: The number of neurons in the 3rd layer.
-  constexpr int H3 = 64;
-
-  // Specifying the NN model.
-  FFN<MeanSquaredError<>, HeInitialization> model;
-
-  // This intermediate layer is needed for connection between input
-  // data and the next LeakyReLU layer.
-  // Parameters specify the number of input features and number of
-  // neurons in the next layer.
-  model.Add<Linear<>>(training_data.n_rows, H1);
-  // Activation layer:
-  model.Add<LeakyReLU<>>();
-  // Connection layer between two activation layers.
-  model.Add<Linear<>>(H1, H2);
-  // Activation layer.
-  model.Add<LeakyReLU<>>();
-  // Connection layer.
-  model.Add<Linear<>>(H2, H3);
-  // Activation layer.
-  model.Add<LeakyReLU<>>();
-  // Connection layer => output.
-  // The output of one neuron is the regression output for one set of PMF
-  // parameters
-  model.Add<Linear<>>(H3, 1);
-
-  // Set parameters for the Stochastic Gradient Descent (SGD) optimizer.
-  ens::Adam optimizer(
-      1e-3,  // Step size of the optimizer.
-      36, // Batch size. Number of data points that are used in each
-                  // iteration.
-      0.9,        // Exponential decay rate for the first moment estimates.
-      0.999,      // Exponential decay rate for the weighted infinity norm
-                  // estimates.
-      1e-8, // Value used to initialise the mean squared gradient parameter.
-      1e8, // Max number of iterations, 0 = unlimited
-      1e-2); // Tolerance.
-
-
-  
-
-  model.Train(training_data,
-              training_outputs,
-              optimizer,
-              // PrintLoss Callback prints loss for each epoch.
-              ens::PrintLoss());
-              // Progressbar Callback prints progress bar for each epoch.
-              // ens::ProgressBar(5),
-              // Stops the optimization process if the loss stops decreasing
-              // or no improvement has been made. This will terminate the
-              // optimization once we obtain a minima on training set.
-              // ens::EarlyStopAtMinLoss(20));
-
-  std::cout << "Finished training." << std::endl;
-
-  // Create predictions on the dataset.
-  arma::mat predicted_num_steps;
-  model.Predict(testing_data, predicted_num_steps);
-
-  // We will test the quality of our model by calculating Mean Squared Error on
-  // validation dataset.
-  double testing_MSE = MSE(testing_outputs, predicted_num_steps);
-  std::cout << "Mean Squared Error on Predicted Number of Steps: ";
-  std::cout << testing_MSE << std::endl;
-
-  // Save the prediction results.
-  bool saved = data::Save("testing_predictions.csv", predicted_num_steps, true, true, arma::csv_ascii);
-  if (!saved) {
-    std::cout << "Failed to save prediction results" << std::endl;
+  try {
+    // Training data is streamed from disk in batches and never held in
+    // memory at once, except by a sweep. Each batch holds one case per
+    // column.
+    std::cout << "Reading training grid walk parameters and results from ";
+    std::cout << argv[1] << std::endl;
+    util::ResultsReader trainingReader(argv[1]);
+    if (trainingReader.num_columns() <= NumFeatures) {
+      std::cout << "Error reading data file " << argv[1] << std::endl;
+      return 2;
+    }
+
+    // The PMF parameters and the mean number of steps, which spans from tens
+    // to hundreds of steps, are scaled separately.
+    util::Scaler featureScaler(NumFeatures, settings.scaling);
+    util::Scaler outputScaler(1, settings.scaling);
+    FitScalers(trainingReader, settings, featureScaler, outputScaler);
+    std::ofstream scalerFile("surrogate_scalers.txt");
+    featureScaler.write(scalerFile);
+    outputScaler.write(scalerFile);
+    scalerFile.close();
+
+    // A sweep keeps the model with the lowest validation MSE, otherwise a
+    // single model of the default configuration is streamed.
+    SweepConfig config;
+    std::unique_ptr<Model> trained;
+    if (sweep.jobs > 0)
+    {
+      trained = RunSweep(trainingReader, settings, sweep, featureScaler,
+                         outputScaler, config);
+      const auto& widths = config.widths;
+      std::cout << "Best configuration " << widths[0] << "x" << widths[1]
+                << "x" << widths[2] << " step " << config.stepSize
+                << " batch " << config.batchSize << std::endl;
+    }
+    else
+    {
+      // Specifying the NN model.
+      trained = std::make_unique<Model>();
+      BuildModel(*trained);
+      TrainStreaming(*trained, trainingReader, settings, featureScaler,
+                     outputScaler);
+    }
+    Model& model = *trained;
+
+    std::cout << "Finished training." << std::endl;
+
+    // Create predictions on the testing dataset, batch by batch, in the
+    // original units.
+    std::cout << "Reading testing grid walk parameters and results from ";
+    std::cout << argv[2] << std::endl;
+    util::ResultsReader testingReader(argv[2]);
+    arma::rowvec predicted_num_steps, testing_outputs;
+    arma::mat features, outputs, predictions;
+    while (ReadScaledBatch(testingReader, settings, featureScaler,
+                           outputScaler, features, outputs) > 0)
+    {
+      model.Predict(features, predictions);
+      outputScaler.inverse_transform(predictions.memptr(), predictions.n_elem,
+                                     1);
+      outputScaler.inverse_transform(outputs.memptr(), outputs.n_elem, 1);
+      predicted_num_steps = arma::join_rows(predicted_num_steps,
+                                            predictions.row(0));
+      testing_outputs = arma::join_rows(testing_outputs, outputs.row(0));
+    }
+
+    // We will test the quality of our model by calculating Mean Squared
+    // Error on validation dataset.
+    double testing_MSE = MSE(testing_outputs, predicted_num_steps);
+    std::cout << "Mean Squared Error on Predicted Number of Steps: ";
+    std::cout << testing_MSE << std::endl;
+
+    // Save the prediction results.
+    arma::mat predicted = predicted_num_steps;
+    bool saved = data::Save("testing_predictions.csv", predicted, true,
+                            true, arma::csv_ascii);
+    if (!saved) {
+      std::cout << "Failed to save prediction results" << std::endl;
+      return 2;
+    }
+
+    // Export the weights, with the scalings folded in, for scoring without
+    // mlpack.
+    if (!ExportModel(model, "surrogate_model.gwm", &featureScaler,
+                     &outputScaler, config.widths[0], config.widths[1],
+                     config.widths[2])) {
+      std::cout << "Failed to export surrogate model" << std::endl;
+      return 2;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
     return 2;
   }
 
   return 0;
-}
\ No newline at end of file
+}
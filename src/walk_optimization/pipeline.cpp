@@ -0,0 +1,116 @@
+// Generates grid walk training and testing data in memory and trains the
+// surrogate model on it directly, without writing or parsing results files
+#include "surrogate_model.hpp"
+#include "walk_manager.hpp"
+#include "util/grid.hpp"
+#include "util/results_writer.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace mlpack;
+using namespace surrogate;
+
+/*
+ * Collects walk results into a matrix with one case per column, in the same
+ * layout as the binary results files written by gridwalk.
+ */
+class MatrixSink : public util::ResultsSink
+{
+ public:
+  MatrixSink(arma::mat& results) : results(results), numCases(0)
+  {
+    results.set_size(util::num_result_columns, 64);
+  }
+
+  void write(const util::CaseResult& result) override
+  {
+    if (numCases == results.n_cols)
+      results.resize(results.n_rows, 2 * results.n_cols);
+    util::to_result_row(result, results.colptr(numCases));
+    ++numCases;
+  }
+
+  //! Shrink the matrix to the number of cases written.
+  void Finalize() { results.resize(results.n_rows, numCases); }
+
+ private:
+  arma::mat& results;
+  arma::uword numCases;
+};
+
+/*
+ * Run all walks of a walk parameters file on the grid and collect the
+ * results in data.
+ */
+bool GenerateData(Grid& grid, const std::string& filename, arma::mat& data)
+{
+  std::ifstream input(filename);
+  if (!input.is_open())
+  {
+    std::cout << "Failed to open " << filename << std::endl;
+    return false;
+  }
+  std::cout << "Generating grid walk data from " << filename << std::endl;
+  WalkManager manager(input);
+  MatrixSink sink(data);
+  manager.execute(&grid, sink);
+  sink.Finalize();
+  return true;
+}
+
+int main(int argc, char* argv [])
+{
+  if (argc != 4) {
+    std::cout << "Must pass grid, training walk parameters, and testing walk "
+              << "parameters files" << std::endl;
+    return 1;
+  }
+
+  std::ifstream gridInput(argv[1], std::ios::in | std::ios::binary);
+  if (!gridInput.is_open())
+  {
+    std::cout << "Failed to open " << argv[1] << std::endl;
+    return 2;
+  }
+  Grid grid(gridInput);
+  gridInput.close();
+
+  // In Armadillo rows represent features, columns represent data points.
+  arma::mat trainingData, testingData;
+  if (!GenerateData(grid, argv[2], trainingData) ||
+      !GenerateData(grid, argv[3], testingData))
+  {
+    return 2;
+  }
+
+  arma::mat trainingOutputs, testingOutputs;
+  SplitResults(trainingData, trainingData, trainingOutputs);
+  SplitResults(testingData, testingData, testingOutputs);
+
+  Model model;
+  BuildModel(model);
+  ens::Adam optimizer = MakeOptimizer();
+  model.Train(trainingData, trainingOutputs, optimizer, ens::PrintLoss());
+  std::cout << "Finished training." << std::endl;
+
+  arma::mat predictedNumSteps;
+  model.Predict(testingData, predictedNumSteps);
+  std::cout << "Mean Squared Error on Predicted Number of Steps: ";
+  std::cout << MSE(predictedNumSteps, testingOutputs) << std::endl;
+
+  bool saved = data::Save("testing_predictions.csv", predictedNumSteps, true,
+      true, arma::csv_ascii);
+  if (!saved) {
+    std::cout << "Failed to save prediction results" << std::endl;
+    return 2;
+  }
+
+  if (!ExportModel(model, "surrogate_model.gwm")) {
+    std::cout << "Failed to export surrogate model" << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
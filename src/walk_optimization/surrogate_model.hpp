@@ -0,0 +1,195 @@
+// Surrogate model shared by gridwalkopt and gridwalk_pipeline
+// A feed forward network predicting the mean number of steps of a grid walk
+// from its 9 PMF parameters
+#ifndef __SURROGATE_MODEL_HEADER__
+#define __SURROGATE_MODEL_HEADER__
+
+#include <mlpack/prereqs.hpp>
+#include <mlpack/core.hpp>
+#include <mlpack/methods/ann/loss_functions/mean_squared_error.hpp>
+#include <mlpack/methods/ann/layer/layer.hpp>
+#include <mlpack/methods/ann/ffn.hpp>
+#include <mlpack/methods/ann/init_rules/he_init.hpp>
+#include <ensmallen.hpp>
+
+#include "util/mlp.hpp"
+#include "util/results_reader.hpp"
+#include "util/scaler.hpp"
+
+#include <fstream>
+#include <string>
+
+namespace surrogate {
+
+//! The network type of the surrogate model.
+using Model = mlpack::ann::FFN<mlpack::ann::MeanSquaredError<>,
+                               mlpack::ann::HeInitialization>;
+
+//! - NumFeatures: The number of PMF parameters of a walk.
+constexpr arma::uword NumFeatures = 9;
+//! - H1: The number of neurons in the 1st layer.
+constexpr int H1 = 64;
+//! - H2: The number of neurons in the 2nd layer.
+constexpr int H2 = 128;
+//! - H3: The number of neurons in the 3rd layer.
+constexpr int H3 = 64;
+
+/*
+ * Function to calculate MSE for arma::cube.
+ */
+inline double MSE(const arma::mat& pred, const arma::mat& Y)
+{
+  return mlpack::metric::SquaredEuclideanDistance::Evaluate(pred, Y) /
+      (Y.n_elem);
+}
+
+/*
+ * Load a results file written by gridwalk. CSV files hold one case per row
+ * and are transposed on reading, binary files are armadillo matrices that
+ * already hold one case per column.
+ */
+inline bool LoadResults(const std::string& filename, arma::mat& data)
+{
+  const std::string extension = ".bin";
+  if (filename.size() >= extension.size() &&
+      filename.compare(filename.size() - extension.size(), extension.size(),
+                       extension) == 0)
+  {
+    return mlpack::data::Load(filename, data, true, false, arma::arma_binary);
+  }
+  return mlpack::data::Load(filename, data, true, true, arma::csv_ascii);
+}
+
+/*
+ * Read the next batch of up to maxCases cases of a results file into data,
+ * one case per column. Returns the number of cases read, 0 at the end.
+ */
+inline size_t ReadBatch(util::ResultsReader& reader,
+                        const size_t maxCases,
+                        arma::mat& data)
+{
+  std::vector<double> batch;
+  const size_t numRead = reader.read_batch(maxCases, batch);
+  data = arma::mat(batch.data(), reader.num_columns(), numRead);
+  return numRead;
+}
+
+/*
+ * Split walk results with one case per column into the PMF parameter
+ * features and the mean number of steps. Rows 0-8 are the PMF parameters
+ * and row 9 is the mean number of steps, any following rows (error,
+ * samples, and runtime) are dropped. features may be data itself.
+ */
+inline void SplitResults(const arma::mat& data,
+                         arma::mat& features,
+                         arma::mat& outputs)
+{
+  outputs = data.row(NumFeatures);
+  features = data.rows(0, NumFeatures - 1);
+}
+
+/*
+ * Add the layers of the surrogate network to an empty model.
+ */
+inline void BuildModel(Model& model,
+                       const size_t h1 = H1,
+                       const size_t h2 = H2,
+                       const size_t h3 = H3)
+{
+  using namespace mlpack::ann;
+  // This intermediate layer is needed for connection between input
+  // data and the next LeakyReLU layer.
+  // Parameters specify the number of input features and number of
+  // neurons in the next layer.
+  model.Add<Linear<>>(NumFeatures, h1);
+  // Activation layer:
+  model.Add<LeakyReLU<>>();
+  // Connection layer between two activation layers.
+  model.Add<Linear<>>(h1, h2);
+  // Activation layer.
+  model.Add<LeakyReLU<>>();
+  // Connection layer.
+  model.Add<Linear<>>(h2, h3);
+  // Activation layer.
+  model.Add<LeakyReLU<>>();
+  // Connection layer => output.
+  // The output of one neuron is the regression output for one set of PMF
+  // parameters
+  model.Add<Linear<>>(h3, 1);
+}
+
+/*
+ * The Adam optimizer used to train the surrogate network.
+ */
+inline ens::Adam MakeOptimizer(const double stepSize = 1e-3,
+                               const size_t batchSize = 36,
+                               const size_t maxIterations = 1e8)
+{
+  return ens::Adam(
+      stepSize,  // Step size of the optimizer.
+      batchSize, // Batch size. Number of data points that are used in each
+                 // iteration.
+      0.9,        // Exponential decay rate for the first moment estimates.
+      0.999,      // Exponential decay rate for the weighted infinity norm
+                  // estimates.
+      1e-8, // Value used to initialise the mean squared gradient parameter.
+      maxIterations, // Max number of iterations, 0 = unlimited
+      1e-2); // Tolerance.
+}
+
+/*
+ * Export the trained weights of a model built by BuildModel to the binary
+ * format scored by util::MLP, which needs neither mlpack nor armadillo.
+ * Each Linear layer stores its out x in weight matrix column major followed
+ * by its out biases in the flat parameters of the network. If the model was
+ * trained on scaled features and outputs the scalings are folded into the
+ * exported weights, so the exported model scores raw PMF parameters.
+ */
+inline bool ExportModel(Model& model,
+                        const std::string& filename,
+                        const util::Scaler* featureScaler = nullptr,
+                        const util::Scaler* outputScaler = nullptr,
+                        const size_t h1 = H1,
+                        const size_t h2 = H2,
+                        const size_t h3 = H3)
+{
+  const size_t sizes[] = { NumFeatures, h1, h2, h3, 1 };
+  const arma::mat& parameters = model.Parameters();
+  util::MLP mlp;
+  size_t offset = 0;
+  for (size_t l = 0; l + 1 < sizeof(sizes) / sizeof(sizes[0]); ++l)
+  {
+    const size_t in = sizes[l];
+    const size_t out = sizes[l + 1];
+    if (offset + out * in + out > parameters.n_elem)
+      return false;
+    std::vector<float> weights(out * in);
+    std::vector<float> biases(out);
+    for (size_t o = 0; o < out; ++o)
+    {
+      for (size_t i = 0; i < in; ++i)
+        weights[o * in + i] = parameters(offset + i * out + o);
+      biases[o] = parameters(offset + out * in + o);
+    }
+    offset += out * in + out;
+    mlp.add_layer(in, out, weights, biases);
+  }
+  if (offset != parameters.n_elem)
+    return false;
+  if (featureScaler)
+    mlp.fold_input_scaling(featureScaler->get_scale(),
+                           featureScaler->get_offset());
+  if (outputScaler)
+    mlp.fold_output_scaling(outputScaler->get_scale(),
+                            outputScaler->get_offset());
+
+  std::ofstream output(filename, std::ios::out | std::ios::binary);
+  if (!output.is_open())
+    return false;
+  mlp.write(output);
+  return output.good();
+}
+
+} // namespace surrogate
+
+#endif
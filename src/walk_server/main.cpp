@@ -0,0 +1,79 @@
+// Long running grid walk evaluation server, see walk_server.hpp for the
+// request protocol
+#include "walk_server.hpp"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Prints the command line usage
+static void print_usage() {
+  std::cout << "Usage: gridwalk_server [options]\n";
+  std::cout << "Options:\n";
+  std::cout << "  --grid id file   load a grid under id, may be repeated\n";
+  std::cout << "  --workers n      walk threads, 0 uses all (default 0)\n";
+  std::cout << "  --cache n        max memoized results (default 65536)\n";
+  std::cout << "  --cache-file file persistent result cache shared with ";
+  std::cout << "gridwalk --cache\n";
+  std::cout << "  --socket path    serve a Unix domain socket instead of ";
+  std::cout << "stdin" << std::endl;
+}
+
+int main(int argc, char* argv []) {
+  std::vector<std::pair<std::string, std::string>> grids;
+  unsigned int num_workers = 0;
+  size_t cache_size = 1 << 16;
+  std::string socket_path;
+  std::string cache_filename;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string option(argv[i]);
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for option "+option);
+      }
+      if (option == "--grid" && i+2 < argc) {
+        grids.emplace_back(argv[i+1], argv[i+2]);
+        i += 2;
+      }
+      else if (option == "--workers") { num_workers = std::stoul(argv[++i]); }
+      else if (option == "--cache") { cache_size = std::stoull(argv[++i]); }
+      else if (option == "--cache-file") { cache_filename = argv[++i]; }
+      else if (option == "--socket") { socket_path = argv[++i]; }
+      else { throw std::runtime_error("Unknown option "+option); }
+    }
+  }
+  catch (const std::exception & e) {
+    std::cout << e.what() << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  try {
+    std::unique_ptr<util::ResultCache> result_cache;
+    WalkServer server(num_workers, cache_size);
+    if (!cache_filename.empty()) {
+      result_cache = std::make_unique<util::ResultCache>(cache_filename);
+      server.set_result_cache(result_cache.get());
+    }
+    for (const auto & grid : grids) {
+      server.load_grid(grid.first, grid.second);
+    }
+    if (socket_path.empty()) {
+      std::ios::sync_with_stdio(false);
+      server.serve_stream(std::cin, std::cout);
+    }
+    else {
+      std::cerr << "Serving on " << socket_path << std::endl;
+      server.serve_socket(socket_path);
+    }
+  }
+  catch (const std::exception & e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}